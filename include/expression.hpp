@@ -0,0 +1,57 @@
+#ifndef EXPRESSION_HPP
+#define EXPRESSION_HPP
+
+#include "layout.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Per-cell parameter expressions, e.g. "45 * rand() * (u + v) / 2".
+//
+// Variables: row, col, index (Cell::id), u, v (cell center over the canvas
+//            width and height, in [0, 1]),
+//            x, y (cell center), pi
+// Functions: sin, cos, abs, sqrt, floor, min, max, pow,
+//            rand() (uniform [0, 1), fixed per cell and call site),
+//            noise(a, b) (smooth value noise in [0, 1])
+// Operators: + - * / ^, unary minus, parentheses
+
+enum class ExprOp : uint8_t {
+    Const, Var,
+    Add, Sub, Mul, Div, Pow, Neg,
+    Sin, Cos, Abs, Sqrt, Floor, Min, Max,
+    Rand, Noise
+};
+
+enum ExprVar { VarRow, VarCol, VarIndex, VarU, VarV, VarX, VarY, VarCount };
+
+struct ExprInstruction {
+    ExprOp op;
+    int arg;  // constant index, variable, or rand() call site
+};
+
+// Stack bytecode, compiled once and evaluated over batches of cells
+struct Expression {
+    std::string source;
+    std::vector<ExprInstruction> code;
+    std::vector<double> constants;
+    int maxStack = 0;
+};
+
+// Cell inputs in structure-of-arrays form, one entry per cell
+struct ExprInputs {
+    std::vector<double> vars[VarCount];
+    std::vector<int> ids;  // Cell::id
+    size_t size() const { return ids.size(); }
+};
+
+// Returns false and sets error on a syntax error
+bool compile_expression(const std::string& source, Expression& out, std::string& error);
+
+ExprInputs expression_inputs(const Canvas& canvas, const std::vector<Cell>& cells);
+
+// Evaluates the expression for every cell: each instruction runs over a
+// whole batch of lanes in a tight loop the compiler can vectorize
+void evaluate_expression(const Expression& expr, const ExprInputs& inputs, uint64_t seed, std::vector<double>& out);
+
+#endif // EXPRESSION_HPP
@@ -0,0 +1,100 @@
+#ifndef GZIP_STREAM_HPP
+#define GZIP_STREAM_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Streaming gzip output (.svgz, .html.gz). Text written to a GzipOStream is
+// deflated one buffer at a time and written to the sink, so the uncompressed
+// document is never held in memory.
+// Build with ALMIGHTY_ZLIB defined (and link zlib) to deflate with zlib;
+// otherwise a built-in encoder is used (LZ77 with hash chains, fixed Huffman
+// codes), which is faster to set up but compresses somewhat less.
+
+struct GzipOptions {
+    int level = 6;             // 0 stores without compression, 1 fastest .. 9 smallest
+    bool thread = false;       // deflate on a separate thread while the renderer runs
+    size_t bufferSize = 1 << 16;
+};
+
+uint32_t crc32_update(uint32_t crc, const uint8_t* data, size_t size);
+
+// Compresses a sequence of buffers into one gzip member
+struct Deflater {
+    virtual ~Deflater() {}
+    // Appends the compressed form of data to out; `last` ends the stream.
+    // Returns false if the encoder failed.
+    virtual bool compress(const uint8_t* data, size_t size, bool last, std::string& out) = 0;
+};
+
+// Returns nullptr if the encoder cannot be set up
+std::unique_ptr<Deflater> make_deflater(int level);
+
+struct GzipStreamBuf : std::streambuf {
+    GzipStreamBuf(std::ostream& sink, const GzipOptions& options);
+    ~GzipStreamBuf() override;
+
+    // Compresses what is left, writes the gzip trailer and waits for the
+    // compressor thread; returns false if the sink or the encoder failed
+    bool finish();
+    bool ok() const { return !failed; }
+
+protected:
+    int_type overflow(int_type c) override;
+    // Leaves the buffered text in place: compressing a partial buffer would
+    // close a deflate block on every std::endl. Data reaches the sink when
+    // the buffer fills and at finish().
+    int sync() override;
+
+private:
+    void submit(bool last);
+    void compress_data(const char* data, size_t size, bool last);
+    void worker();
+
+    std::ostream& sink;
+    GzipOptions options;
+    std::unique_ptr<Deflater> deflater;
+    std::vector<char> buffer;
+    std::string compressed;
+    bool finished = false;
+    std::atomic<bool> failed{false};
+
+    // Compressor thread: full buffers are queued and recycled
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::vector<std::vector<char>> queue;
+    std::vector<std::vector<char>> spare;
+    bool lastQueued = false;
+};
+
+struct GzipOStream : std::ostream {
+    // Starts in the bad state if the encoder cannot be set up
+    explicit GzipOStream(std::ostream& sink, const GzipOptions& options = GzipOptions{});
+    // Must be called once writing is done; see GzipStreamBuf::finish()
+    bool finish() { return buf.finish(); }
+
+private:
+    GzipStreamBuf buf;
+};
+
+// True for paths that should be written compressed (.svgz, .gz)
+bool is_gzip_path(const std::string& path);
+
+// Opens path and runs writer on a gzip stream over it
+bool write_gzip_file(
+    const std::string& path,
+    const std::function<void(std::ostream&)>& writer,
+    const GzipOptions& options = GzipOptions{}
+);
+
+#endif // GZIP_STREAM_HPP
@@ -0,0 +1,71 @@
+#ifndef LAYOUT_HPP
+#define LAYOUT_HPP
+
+#include "canvas.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A placed instance of canvas.baseObject. id is the cell's index in the
+// full layout (all rows), unique even where non-grid layouts put several
+// cells on the same row/col.
+struct Cell {
+    int row, col;
+    Point center;
+    int id;
+};
+
+// Layout stage configuration
+struct Layout {
+    std::string type = "grid";  // "grid", "hex", "jittered" or "poisson"
+    double jitter = 0.5;        // jittered: max offset as a fraction of the spacing
+    double minDistance = 0;     // poisson: minimum distance, 0 uses the grid spacing
+    int maxAttempts = 30;       // poisson: candidates tried around each active sample
+    uint64_t seed = 0;          // jittered/poisson: 0 picks a random seed
+};
+
+// Cell centers for the canvas, ordered by row then column.
+// Non-grid layouts assign row/col from the nearest grid cell.
+// Only rows in [rowBegin, rowEnd) are returned, rowEnd = -1 means all rows;
+// cells do not depend on the row range.
+std::vector<Cell> layout_cells(const Canvas& canvas, const Layout& layout = Layout{},
+                               int rowBegin = 0, int rowEnd = -1);
+
+// Cells of rows [rowBegin, rowEnd) from a full layout (rowEnd = -1 means all
+// rows), so a layout computed once can be rendered band by band
+std::vector<Cell> cells_in_rows(const std::vector<Cell>& cells, int rowBegin, int rowEnd = -1);
+
+std::vector<Cell> grid_layout(const Canvas& canvas, int rowBegin = 0, int rowEnd = -1);
+std::vector<Cell> hex_layout(const Canvas& canvas, int rowBegin = 0, int rowEnd = -1);
+std::vector<Cell> jittered_layout(const Canvas& canvas, double jitter, uint64_t seed,
+                                  int rowBegin = 0, int rowEnd = -1);
+std::vector<Cell> poisson_layout(const Canvas& canvas, double minDistance, int maxAttempts, uint64_t seed);
+
+// Deterministic per-cell seed, independent of the order cells are visited in
+uint64_t cell_seed(uint64_t seed, int row, int col);
+uint64_t cell_seed(uint64_t seed, const Cell& cell);
+
+// Returns seed, or a random seed when it is 0
+uint64_t resolve_seed(uint64_t seed);
+
+// Uniform spatial hash over points in [0, width) x [0, height).
+// Buckets are intrusive linked lists, so there are no per-bucket allocations.
+struct SpatialHash {
+    SpatialHash(double width, double height, double cellSize);
+
+    int insert(Point p);  // returns the new point id
+    bool any_within(Point p, double radius) const;
+    void query(Point p, double radius, std::vector<int>& out) const;
+
+    double cellSize;
+    int gridW, gridH;
+    std::vector<int> head;    // first id in each bucket, -1 if empty
+    std::vector<int> next;    // next id in the same bucket
+    std::vector<Point> points;
+
+private:
+    int bucket_x(double x) const;
+    int bucket_y(double y) const;
+};
+
+#endif // LAYOUT_HPP
@@ -0,0 +1,88 @@
+#ifndef MEMORY_STATS_HPP
+#define MEMORY_STATS_HPP
+
+#include <cstdint>
+#include <string>
+
+// Opt-in allocation tracking for render calls.
+// Build with ALMIGHTY_MEMORY_TRACKING defined to replace the global operator
+// new/delete with counting versions; without it the scopes compile to nothing.
+// Counters are process-wide and reports assume one render call at a time.
+
+struct MemoryStats {
+    uint64_t allocations = 0;
+    uint64_t bytes = 0;          // requested bytes
+    uint64_t peakLiveBytes = 0;  // above the live bytes at scope start
+};
+
+struct StageMemory {
+    const char* name = nullptr;
+    MemoryStats stats;
+};
+
+// Filled in by the outermost MemoryRenderScope when it closes
+struct RenderMemoryReport {
+    static const int maxStages = 8;
+
+    const char* call = "";
+    MemoryStats total;
+    StageMemory stages[maxStages];
+    int stageCount = 0;
+    uint64_t cells = 0;
+    uint64_t vertices = 0;
+
+    const MemoryStats* stage(const char* name) const;
+    double allocations_per_cell() const;
+    double allocations_per_vertex() const;
+    double bytes_per_vertex() const;
+};
+
+bool memory_tracking_enabled();
+uint64_t memory_live_bytes();
+const RenderMemoryReport& memory_last_report();
+std::string memory_report_to_string(const RenderMemoryReport& report);
+
+#ifdef ALMIGHTY_MEMORY_TRACKING
+
+// Tracks one render call; nested render calls fold into the outer one
+class MemoryRenderScope {
+public:
+    explicit MemoryRenderScope(const char* call);
+    ~MemoryRenderScope();
+    void add_cells(uint64_t cells, uint64_t vertices);
+
+private:
+    bool outer_;
+    uint64_t allocations_, bytes_, live_, savedPeak_;
+};
+
+// Attributes allocations to a named stage of the current render call.
+// Stages may be opened repeatedly (e.g. once per cell) and accumulate.
+class MemoryStageScope {
+public:
+    explicit MemoryStageScope(const char* stage);
+    ~MemoryStageScope() { close(); }
+    void close();  // end the stage before the scope does
+
+private:
+    const char* stage_;
+    uint64_t allocations_, bytes_, live_, savedPeak_;
+};
+
+#else
+
+class MemoryRenderScope {
+public:
+    explicit MemoryRenderScope(const char*) {}
+    void add_cells(uint64_t, uint64_t) {}
+};
+
+class MemoryStageScope {
+public:
+    explicit MemoryStageScope(const char*) {}
+    void close() {}
+};
+
+#endif // ALMIGHTY_MEMORY_TRACKING
+
+#endif // MEMORY_STATS_HPP
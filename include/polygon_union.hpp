@@ -0,0 +1,37 @@
+#ifndef POLYGON_UNION_HPP
+#define POLYGON_UNION_HPP
+
+#include "canvas.hpp"
+#include <string>
+#include <vector>
+
+// Signed area, positive for counter-clockwise rings in a y-up frame
+double polygon_area(const std::vector<Point>& polygon);
+
+// Boolean union of simple polygons. Edge intersections are found with a
+// sweep over x that tests each edge against every active edge overlapping
+// it in x. The active list is unordered, so this is O(n^2) in the worst case
+// (many long horizontal edges); it is meant for the few polygons of a cell.
+// The split edges that are not inside another polygon are then linked into
+// rings. Outer rings have positive area, holes negative. Returns false when the boundary is ambiguous (two
+// rings meeting at a single vertex), in which case rings is left empty.
+bool polygon_union(const std::vector<std::vector<Point>>& polygons, std::vector<std::vector<Point>>& rings);
+
+// True if inner lies entirely inside outer (shared boundary allowed)
+bool polygon_contains(const std::vector<Point>& outer, const std::vector<Point>& inner);
+
+// True if color is a fill known to paint fully opaque: an SVG color keyword,
+// #rgb, #rrggbb, or rgb()/hsl() without alpha. none, transparent,
+// currentColor, inherit, unknown keywords, colors with alpha and anything
+// carrying extra attributes are not.
+bool is_opaque_color(const std::string& color);
+
+// Geometry reduction before output, keeping the painted image the same:
+// drops objects fully covered by a later opaque object, then merges
+// overlapping or touching opaque objects of the same color into their union
+// when no differently colored object painted between the two overlaps the
+// part that moves. A merge is kept only if it has no more vertices than the
+// two inputs.
+void reduce_objects(std::vector<Object>& objects);
+
+#endif // POLYGON_UNION_HPP
@@ -0,0 +1,109 @@
+#ifndef PREVIEW_SERVER_HPP
+#define PREVIEW_SERVER_HPP
+
+#include "canvas.hpp"
+#include "shard.hpp"
+#include "svg_utils.hpp"
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Least recently used documents, bounded by their total size in bytes
+struct RenderCache {
+    explicit RenderCache(size_t maxBytes = 64 << 20) : maxBytes(maxBytes) {}
+
+    // Returns nullptr on a miss; a hit becomes the most recently used entry
+    const std::string* get(const std::string& key);
+    // Documents larger than maxBytes are not kept
+    void put(const std::string& key, std::string document);
+
+    size_t maxBytes;
+    size_t bytes = 0;
+    std::list<std::pair<std::string, std::string>> entries;  // most recent first
+    std::unordered_map<std::string, std::list<std::pair<std::string, std::string>>::iterator> lookup;
+};
+
+struct PreviewScene {
+    Canvas canvas;
+    ShardRenderer renderer;  // writes the cell elements of a band of rows
+    RenderOptions options;   // options.seed is the default for requests without ?seed=
+};
+
+struct PreviewServerConfig {
+    std::string host = "127.0.0.1";
+    int port = 8080;             // 0 picks a free port, see PreviewServer::port()
+    int rowsPerChunk = 4;        // rows serialized per chunk of the response
+    size_t cacheBytes = 64 << 20;
+    int maxConnections = 1024;
+};
+
+struct PreviewConnection;
+
+// HTTP/1.1 preview server on a single epoll loop. Routes:
+//   GET /                          list of scenes
+//   GET /scene/<name>?seed=N       HTML page around the SVG
+//   GET /scene/<name>.svg?seed=N   SVG document
+// Renders are streamed with chunked transfer encoding, one band of rows per
+// chunk (HTTP/1.0 clients get the bands unframed, ended by closing the
+// connection), so the first bytes go out before the rest of the grid is laid out.
+// Finished documents are cached by scene and seed. Each writable event of a
+// connection renders one band, which keeps concurrent clients interleaved.
+// Bands render on the loop thread, so while one renders every other client
+// waits, cache hits included: a slow scene stalls the whole server. It is
+// meant for a few local clients previewing scenes, not for serving them.
+struct PreviewServer {
+    explicit PreviewServer(const PreviewServerConfig& config = PreviewServerConfig{});
+    ~PreviewServer();
+
+    // Adds or replaces a scene; may be called while the server runs.
+    // Responses already streaming finish with the scene they started on.
+    void add_scene(const std::string& name, const PreviewScene& scene);
+    // The current version of a scene, nullptr if there is none
+    std::shared_ptr<const PreviewScene> find_scene(const std::string& name) const;
+
+    // Bind and listen; returns false if the socket cannot be set up
+    bool start();
+    int port() const { return boundPort; }
+
+    // Serve until stop() is called (from any thread or a signal handler)
+    void run();
+    void stop();
+    // Handle the events ready within timeoutMs; returns false once stopped
+    bool poll(int timeoutMs);
+
+    PreviewServerConfig config;
+    RenderCache cache;
+
+private:
+    // A replaced scene gets a new version, which keeps its cached documents apart
+    struct SceneEntry {
+        std::shared_ptr<const PreviewScene> scene;
+        uint64_t version = 0;
+    };
+
+    void accept_clients();
+    bool read_input(PreviewConnection& conn);
+    bool pump(PreviewConnection& conn, bool writable);
+    bool next_request(PreviewConnection& conn);
+    void handle_request(PreviewConnection& conn, const std::string& method, const std::string& target);
+    void render_next_band(PreviewConnection& conn);
+    bool write_output(PreviewConnection& conn);
+    void update_events(PreviewConnection& conn);
+    void close_connection(int fd);
+
+    int listenFd = -1;
+    int epollFd = -1;
+    int wakeFd = -1;
+    int boundPort = 0;
+    bool stopped = false;
+    mutable std::mutex scenesMutex;
+    std::map<std::string, SceneEntry> scenes;
+    uint64_t sceneVersion = 0;
+    std::unordered_map<int, std::unique_ptr<PreviewConnection>> connections;
+};
+
+#endif // PREVIEW_SERVER_HPP
@@ -0,0 +1,72 @@
+#ifndef SCENE_HPP
+#define SCENE_HPP
+
+#include "canvas.hpp"
+#include "geometry.hpp"
+#include "layout.hpp"
+#include <memory>
+#include <string>
+#include <vector>
+
+// 2D affine matrix, same layout as SVG matrix(a,b,c,d,e,f):
+// x' = a*x + c*y + e
+// y' = b*x + d*y + f
+struct Matrix {
+    double a = 1, b = 0, c = 0, d = 1, e = 0, f = 0;
+};
+
+// Matrix helpers (angles in degrees, like Transform)
+Matrix matrix_translate(double tx, double ty);
+Matrix matrix_rotate(double angle, Point center);
+Matrix matrix_scale(double k, Point center);
+Matrix matrix_from_transform(const Transform& transform, Point center);
+Matrix matrix_multiply(const Matrix& m, const Matrix& n); // m * n, n is applied first
+Point matrix_apply(const Matrix& m, const Point& p);
+bool matrix_is_identity(const Matrix& m);
+std::string matrix_to_svg(const Matrix& m);
+
+// Group node of the scene graph: a local transform, leaf objects and child groups.
+// World matrices are cached and only recomputed for dirty subtrees.
+struct SceneNode {
+    explicit SceneNode(const std::string& name = "");
+
+    SceneNode* add_child(const std::string& name = "");
+    void add_object(const Object& obj);
+
+    void set_local(const Matrix& m);
+    void apply(const Matrix& m);                           // local = m * local
+    void apply(const Transform& transform, Point center);
+
+    const Matrix& local() const { return local_; }
+    const Matrix& world() const;
+    bool dirty() const { return dirty_; }
+
+    const std::string& name() const { return name_; }
+    SceneNode* parent() const { return parent_; }
+    const std::vector<Object>& objects() const { return objects_; }
+    std::vector<Object>& objects() { return objects_; }
+    const std::vector<std::unique_ptr<SceneNode>>& children() const { return children_; }
+
+private:
+    void invalidate();
+
+    std::string name_;
+    Matrix local_;
+    mutable Matrix world_;
+    mutable bool dirty_ = true;
+    SceneNode* parent_ = nullptr;
+    std::vector<Object> objects_;
+    std::vector<std::unique_ptr<SceneNode>> children_;
+};
+
+// Build a scene with one group per layout cell, each holding a copy of canvas.baseObject
+std::unique_ptr<SceneNode> scene_from_canvas(const Canvas& canvas, const Layout& layout = Layout{});
+
+// Flatten the scene into world-space objects (paint order)
+void scene_flatten(const SceneNode& root, std::vector<Object>& out);
+
+// SVG output: nested <g transform> elements, or flattened geometry
+std::string scene_node_to_svg(const SceneNode& node);
+std::string scene_to_svg(const SceneNode& root, int width, int height, bool flatten = false);
+
+#endif // SCENE_HPP
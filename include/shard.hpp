@@ -0,0 +1,52 @@
+#ifndef SHARD_HPP
+#define SHARD_HPP
+
+#include "canvas.hpp"
+#include "svg_utils.hpp"
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// A band of rows rendered by one worker into its own file
+struct Shard {
+    int index;
+    int rowBegin, rowEnd;
+    std::string path;
+};
+
+// Writes the cell elements for options.rowBegin..options.rowEnd,
+// e.g. a lambda around canvas_transform_composed_write()
+typedef std::function<void(std::ostream&, const RenderOptions&)> ShardRenderer;
+
+// Split the canvas rows into shardCount contiguous bands
+std::vector<Shard> plan_shards(const Canvas& canvas, int shardCount, const std::string& directory);
+
+// Fix the seeds shared by every shard (0 means random, which must be picked once).
+// Call it on one node only: nodes resolving 0 separately get different seeds.
+RenderOptions resolve_shard_options(const RenderOptions& options);
+
+// Render one band to shard.path. options.seed and options.layout.seed must
+// already be resolved (nonzero) and identical for every shard; returns false
+// on a 0 seed instead of picking a random one.
+bool render_shard(const Shard& shard, const ShardRenderer& renderer, const RenderOptions& options);
+
+// Stitch shard files into one SVG by copying their bytes between the
+// document header and footer, without re-parsing the geometry.
+// An outputPath ending in .svgz or .gz is written gzip-compressed.
+bool merge_svg_shards(const Canvas& canvas, const std::vector<Shard>& shards, std::ostream& out);
+bool merge_svg_shards(const Canvas& canvas, const std::vector<Shard>& shards, const std::string& outputPath);
+
+// Render every shard in its own worker process (at most `workers` at a time),
+// then merge them into outputPath
+bool render_sharded(
+    const Canvas& canvas,
+    const ShardRenderer& renderer,
+    const RenderOptions& options,
+    int shardCount,
+    int workers,
+    const std::string& directory,
+    const std::string& outputPath
+);
+
+#endif // SHARD_HPP
@@ -0,0 +1,63 @@
+#ifndef SPATIAL_INDEX_HPP
+#define SPATIAL_INDEX_HPP
+
+#include "canvas.hpp"
+#include "layout.hpp"
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// A rendered object: its cell (Cell::id, row, col) and its index in canvas.baseObject
+struct Hit {
+    int cell, row, col, objectIndex;
+};
+
+struct BBox {
+    double minX, minY, maxX, maxY;
+};
+
+// Transformed polygons collected during rendering (see RenderOptions::index),
+// indexed by a linear BVH: Morton-ordered primitives with a binary radix tree
+// built in parallel (Karras 2012), one primitive per leaf.
+struct SceneIndex {
+    void clear();
+    void add(const Object& obj, const Cell& cell, int objectIndex);
+    void add_cell(const Cell& cell, const std::vector<Object>& objects);
+
+    // Must be called after the last add() and before querying; threads = 0 uses all cores
+    void build(int threads = 0);
+    size_t size() const { return hits.size(); }
+
+    // Objects containing the point, topmost (last painted) first
+    void pick(Point p, std::vector<Hit>& out) const;
+    // Objects overlapping the rectangle or polygon, in paint order
+    void query_rect(const BBox& rect, std::vector<Hit>& out) const;
+    void query_polygon(const std::vector<Point>& polygon, std::vector<Hit>& out) const;
+    // Pairs of objects from different cells that overlap (see polygons_overlap)
+    void overlapping_cells(std::vector<std::pair<Hit, Hit>>& out) const;
+
+    // Primitives in insertion (paint) order
+    std::vector<Hit> hits;
+    std::vector<BBox> boxes;
+    std::vector<Point> points;
+    std::vector<uint32_t> pointOffsets{0};  // polygon k is points[offsets[k] .. offsets[k + 1])
+
+    // Radix tree: internal node i has children left[i]/right[i]; a negative
+    // child ~k is the leaf holding primitive order[k]
+    std::vector<uint32_t> order;
+    std::vector<int> left, right;
+    std::vector<BBox> nodeBoxes;
+
+private:
+    template <typename Overlaps, typename Visit>
+    void traverse(const Overlaps& overlaps, const Visit& visit) const;
+    void query_polygon_ids(const Point* polygon, size_t count, const BBox& box, std::vector<uint32_t>& out) const;
+};
+
+// Geometry predicates used by the queries
+bool point_in_polygon(Point p, const Point* polygon, size_t count);
+// True if the interiors overlap or the boundaries share a piece of an edge;
+// touching at single points does not count
+bool polygons_overlap(const Point* a, size_t countA, const Point* b, size_t countB);
+
+#endif // SPATIAL_INDEX_HPP
@@ -1,51 +1,114 @@
-#ifndef GEOMETRY_HPP
-#define GEOMETRY_HPP
+#ifndef SVG_UTILS_HPP
+#define SVG_UTILS_HPP
 
-#include "canvas.hpp" // Include canvas.hpp to access Object and Point
+#include "canvas.hpp"
+#include "geometry.hpp"
+#include "layout.hpp"
+#include <ostream>
 #include <string>
 #include <vector>
-#include <random>  // Add for random number generation
 
-// Translate an object by (tx, ty)
-void translate_object(Object& obj, double tx, double ty);
+struct SceneIndex;
 
-// Translate a composed object (a vector of objects) by (tx, ty)
-void translate_composedObject(std::vector<Object>& objects, double tx, double ty);
+// Options shared by the canvas renderers
+struct RenderOptions {
+    Layout layout;      // where the copies of canvas.baseObject are placed
+    uint64_t seed = 0;  // per-cell randomness, 0 picks a random seed
+    int rowBegin = 0;   // only cells in rows [rowBegin, rowEnd) are rendered,
+    int rowEnd = -1;    // -1 renders every row
 
-// New function for A6.a
-std::string canvas_list_transform_simpleObject_to_svg(
-    const Canvas& canvas,
-    const std::vector<Transform>& possible_transforms,
-    int objectIndex = -1  // -1 means apply to all objects
-);
+    std::string geometry = "polygon";  // "polygon" (absolute points) or "path" (compact relative path data)
+    double quantum = 0.01;             // path: coordinates are rounded to multiples of this
 
-#endif // GEOMETRY_HPP
+    // "none", "cell" or "canvas": before output, drop hidden polygons and merge
+    // same-color ones (see reduce_objects) within each cell or across the
+    // rendered rows. "canvas" writes nothing until the last cell is done.
+    std::string reduce = "none";
 
-#ifndef SVG_UTILS_HPP
-#define SVG_UTILS_HPP
+    // "none", "geometry" or "svg": transform the base objects once per
+    // distinct transform sequence instead of once per cell. "geometry" offsets
+    // the cached objects to each cell; "svg" also caches their serialized
+    // form and writes each cell as <g transform="translate(x,y)">. "svg" falls
+    // back to "geometry" when an index or a reduction needs absolute points.
+    std::string memoize = "none";
 
-#include "canvas.hpp"
-#include "geometry.hpp"
-#include <string>
-#include <vector>
+    // When set, every rendered object is also added to this index (call
+    // build() on it afterwards). Not filled by sharded worker processes.
+    SceneIndex* index = nullptr;
+
+    // When set, the rows to render are taken from this full layout instead of
+    // running the layout stage, so band-by-band renders share one layout
+    // (a Poisson layout is otherwise regenerated for every band).
+    const std::vector<Cell>* cells = nullptr;
+};
 
 // Basic SVG functions
 std::string point_to_svg(const Point& p);
 std::string object_to_svg(const Object& obj);
 
+// Compact geometry: <path d="M..l..z"> with coordinates quantized to `quantum`,
+// relative commands, minimal number formatting and collinear vertices dropped
+std::string object_to_svg_path(const Object& obj, double quantum = 0.01);
+void write_object_svg_path(std::ostream& out, const Object& obj, double quantum);
+
+// Writes an object in the geometry format selected by the options
+void write_object_svg(std::ostream& out, const Object& obj, const RenderOptions& options);
+
+// SVG document framing
+void write_svg_header(std::ostream& out, int width, int height);
+void write_svg_footer(std::ostream& out);
+
+// Cell elements only (no <svg> framing). Output for a cell does not depend on
+// which rows are rendered, so row bands can be written separately and concatenated.
+void canvas_composed_write(std::ostream& out, const Canvas& canvas, const RenderOptions& options);
+void canvas_transform_composed_write(
+    std::ostream& out,
+    const Canvas& canvas,
+    const std::vector<std::pair<std::string, double>>& transforms,
+    const RenderOptions& options
+);
+void canvas_list_transform_simpleObject_write(
+    std::ostream& out,
+    const Canvas& canvas,
+    const std::vector<Transform>& possible_transforms,
+    int objectIndex,
+    const RenderOptions& options
+);
+// Transform values are per-cell expressions, e.g. {"rotate", "90 * rand() * u * v"}.
+// Returns false, with the compile error in *error when given, if an
+// expression does not compile; nothing is written then.
+bool canvas_expression_transform_composed_write(
+    std::ostream& out,
+    const Canvas& canvas,
+    const std::vector<std::pair<std::string, std::string>>& transforms,
+    const RenderOptions& options,
+    std::string* error = nullptr
+);
+
 // Canvas to SVG conversion functions
-std::string canvas_composed_to_svg(const Canvas& canvas);
+std::string canvas_composed_to_svg(const Canvas& canvas, const RenderOptions& options = RenderOptions{});
 std::string canvas_transform_composed_to_svg(
     const Canvas& canvas,
-    const std::vector<std::pair<std::string, double>>& transforms
+    const std::vector<std::pair<std::string, double>>& transforms,
+    const RenderOptions& options = RenderOptions{}
 );
 std::string canvas_list_transform_simpleObject_to_svg(
     const Canvas& canvas,
     const std::vector<Transform>& possible_transforms,
-    int objectIndex = -1
+    int objectIndex = -1,
+    const RenderOptions& options = RenderOptions{}
+);
+// Returns "" (and the compile error in *error) if an expression does not compile
+std::string canvas_expression_transform_composed_to_svg(
+    const Canvas& canvas,
+    const std::vector<std::pair<std::string, std::string>>& transforms,
+    const RenderOptions& options = RenderOptions{},
+    std::string* error = nullptr
 );
 
-// HTML helper
+// HTML helpers; the header and footer frame a document written piece by piece
+void write_html_header(std::ostream& out, const std::string& title);
+void write_html_footer(std::ostream& out);
 std::string create_html_wrapper(const std::string& svg, const std::string& title);
 
 #endif // SVG_UTILS_HPP
\ No newline at end of file
@@ -0,0 +1,349 @@
+#include "expression.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+
+namespace {
+
+// Recursive descent parser emitting postfix bytecode
+struct Parser {
+    const std::string& src;
+    size_t pos = 0;
+    Expression& out;
+    std::string& error;
+    int depth = 0;
+    int randSites = 0;
+
+    Parser(const std::string& source, Expression& expr, std::string& err) : src(source), out(expr), error(err) {}
+
+    void skip_spaces() {
+        while (pos < src.size() && std::isspace((unsigned char)src[pos])) {
+            ++pos;
+        }
+    }
+
+    bool accept(char c) {
+        skip_spaces();
+        if (pos < src.size() && src[pos] == c) {
+            ++pos;
+            return true;
+        }
+        return false;
+    }
+
+    bool fail(const std::string& message) {
+        if (error.empty()) {
+            error = message + " at position " + std::to_string(pos) + " in \"" + src + "\"";
+        }
+        return false;
+    }
+
+    // Emit an instruction, tracking the stack depth it leaves behind
+    void emit(ExprOp op, int arg, int pops, int pushes) {
+        out.code.push_back({op, arg});
+        depth += pushes - pops;
+        out.maxStack = std::max(out.maxStack, depth);
+    }
+
+    bool parse_expr() {
+        if (!parse_term()) {
+            return false;
+        }
+        while (true) {
+            if (accept('+')) {
+                if (!parse_term()) return false;
+                emit(ExprOp::Add, 0, 2, 1);
+            } else if (accept('-')) {
+                if (!parse_term()) return false;
+                emit(ExprOp::Sub, 0, 2, 1);
+            } else {
+                return true;
+            }
+        }
+    }
+
+    bool parse_term() {
+        if (!parse_unary()) {
+            return false;
+        }
+        while (true) {
+            if (accept('*')) {
+                if (!parse_unary()) return false;
+                emit(ExprOp::Mul, 0, 2, 1);
+            } else if (accept('/')) {
+                if (!parse_unary()) return false;
+                emit(ExprOp::Div, 0, 2, 1);
+            } else {
+                return true;
+            }
+        }
+    }
+
+    bool parse_unary() {
+        if (accept('-')) {
+            if (!parse_unary()) return false;
+            emit(ExprOp::Neg, 0, 1, 1);
+            return true;
+        }
+        if (accept('+')) {
+            return parse_unary();
+        }
+        return parse_power();
+    }
+
+    // ^ is right associative and binds tighter than unary minus on its left
+    bool parse_power() {
+        if (!parse_primary()) {
+            return false;
+        }
+        if (accept('^')) {
+            if (!parse_unary()) return false;
+            emit(ExprOp::Pow, 0, 2, 1);
+        }
+        return true;
+    }
+
+    bool parse_args(int count) {
+        if (!accept('(')) {
+            return fail("Expected '('");
+        }
+        for (int i = 0; i < count; ++i) {
+            if (i > 0 && !accept(',')) {
+                return fail("Expected ','");
+            }
+            if (!parse_expr()) {
+                return false;
+            }
+        }
+        if (!accept(')')) {
+            return fail("Expected ')'");
+        }
+        return true;
+    }
+
+    bool parse_primary() {
+        skip_spaces();
+        if (pos >= src.size()) {
+            return fail("Unexpected end of expression");
+        }
+
+        if (accept('(')) {
+            if (!parse_expr()) return false;
+            if (!accept(')')) return fail("Expected ')'");
+            return true;
+        }
+
+        char c = src[pos];
+        if (std::isdigit((unsigned char)c) || c == '.') {
+            const char* begin = src.c_str() + pos;
+            char* end = nullptr;
+            double value = std::strtod(begin, &end);
+            if (end == begin) {
+                return fail("Invalid number");
+            }
+            pos += end - begin;
+            out.constants.push_back(value);
+            emit(ExprOp::Const, (int)out.constants.size() - 1, 0, 1);
+            return true;
+        }
+
+        if (!std::isalpha((unsigned char)c) && c != '_') {
+            return fail(std::string("Unexpected character '") + c + "'");
+        }
+        size_t start = pos;
+        while (pos < src.size() && (std::isalnum((unsigned char)src[pos]) || src[pos] == '_')) {
+            ++pos;
+        }
+        std::string name = src.substr(start, pos - start);
+
+        static const struct { const char* name; int var; } vars[] = {
+            {"row", VarRow}, {"col", VarCol}, {"index", VarIndex},
+            {"u", VarU}, {"v", VarV}, {"x", VarX}, {"y", VarY}
+        };
+        for (const auto& var : vars) {
+            if (name == var.name) {
+                emit(ExprOp::Var, var.var, 0, 1);
+                return true;
+            }
+        }
+        if (name == "pi") {
+            out.constants.push_back(M_PI);
+            emit(ExprOp::Const, (int)out.constants.size() - 1, 0, 1);
+            return true;
+        }
+
+        static const struct { const char* name; ExprOp op; int args; } functions[] = {
+            {"sin", ExprOp::Sin, 1}, {"cos", ExprOp::Cos, 1}, {"abs", ExprOp::Abs, 1},
+            {"sqrt", ExprOp::Sqrt, 1}, {"floor", ExprOp::Floor, 1},
+            {"min", ExprOp::Min, 2}, {"max", ExprOp::Max, 2}, {"pow", ExprOp::Pow, 2},
+            {"noise", ExprOp::Noise, 2}, {"rand", ExprOp::Rand, 0}
+        };
+        for (const auto& function : functions) {
+            if (name == function.name) {
+                if (!parse_args(function.args)) {
+                    return false;
+                }
+                int arg = function.op == ExprOp::Rand ? randSites++ : 0;
+                emit(function.op, arg, function.args, 1);
+                return true;
+            }
+        }
+        pos = start;
+        return fail("Unknown identifier '" + name + "'");
+    }
+};
+
+const size_t kBatch = 256;
+
+double hash_unit(uint64_t h) {
+    return (h >> 11) * 0x1.0p-53;
+}
+
+// Lattice coordinate of x, kept in 64 bits: user expressions can scale
+// their inputs far beyond the int range. Non-finite inputs map to 0.
+int64_t lattice(double x) {
+    const double limit = 0x1.0p62;
+    return std::isfinite(x) ? (int64_t)std::max(-limit, std::min(limit, x)) : 0;
+}
+
+uint64_t lattice_hash(uint64_t seed, int64_t ix, int64_t iy) {
+    uint64_t h = cell_seed(seed, (int)(iy >> 32), (int)(uint32_t)iy);
+    return cell_seed(h, (int)(ix >> 32), (int)(uint32_t)ix);
+}
+
+// Value noise on an integer lattice with smoothstep interpolation
+double value_noise(double x, double y, uint64_t seed) {
+    double fx = std::floor(x);
+    double fy = std::floor(y);
+    int64_t ix = lattice(fx);
+    int64_t iy = lattice(fy);
+    double tx = x - fx;
+    double ty = y - fy;
+    tx = tx * tx * (3 - 2 * tx);
+    ty = ty * ty * (3 - 2 * ty);
+
+    double a = hash_unit(lattice_hash(seed, ix, iy));
+    double b = hash_unit(lattice_hash(seed, ix + 1, iy));
+    double c = hash_unit(lattice_hash(seed, ix, iy + 1));
+    double d = hash_unit(lattice_hash(seed, ix + 1, iy + 1));
+    double top = a + (b - a) * tx;
+    double bottom = c + (d - c) * tx;
+    return top + (bottom - top) * ty;
+}
+
+// Batch kernels over kBatch lanes. Keeping the trip count fixed and the
+// operands restrict-qualified lets the compiler vectorize them at -O2.
+void op_fill(double* __restrict b, double value) { for (size_t i = 0; i < kBatch; ++i) b[i] = value; }
+void op_add(double* __restrict b, const double* __restrict a) { for (size_t i = 0; i < kBatch; ++i) b[i] += a[i]; }
+void op_sub(double* __restrict b, const double* __restrict a) { for (size_t i = 0; i < kBatch; ++i) b[i] -= a[i]; }
+void op_mul(double* __restrict b, const double* __restrict a) { for (size_t i = 0; i < kBatch; ++i) b[i] *= a[i]; }
+void op_div(double* __restrict b, const double* __restrict a) { for (size_t i = 0; i < kBatch; ++i) b[i] /= a[i]; }
+void op_min(double* __restrict b, const double* __restrict a) { for (size_t i = 0; i < kBatch; ++i) b[i] = b[i] < a[i] ? b[i] : a[i]; }
+void op_max(double* __restrict b, const double* __restrict a) { for (size_t i = 0; i < kBatch; ++i) b[i] = b[i] > a[i] ? b[i] : a[i]; }
+void op_neg(double* __restrict a) { for (size_t i = 0; i < kBatch; ++i) a[i] = -a[i]; }
+void op_abs(double* __restrict a) { for (size_t i = 0; i < kBatch; ++i) a[i] = std::fabs(a[i]); }
+void op_sqrt(double* __restrict a) { for (size_t i = 0; i < kBatch; ++i) a[i] = std::sqrt(a[i]); }
+void op_floor(double* __restrict a) { for (size_t i = 0; i < kBatch; ++i) a[i] = std::floor(a[i]); }
+
+// Loads a partial batch, padding the unused lanes
+void op_load(double* __restrict b, const double* __restrict src, size_t len) {
+    std::copy(src, src + len, b);
+    std::fill(b + len, b + kBatch, 0.0);
+}
+
+} // namespace
+
+bool compile_expression(const std::string& source, Expression& out, std::string& error) {
+    out = Expression{};
+    out.source = source;
+    error.clear();
+
+    Parser parser(source, out, error);
+    if (!parser.parse_expr()) {
+        return false;
+    }
+    parser.skip_spaces();
+    if (parser.pos != source.size()) {
+        return parser.fail("Unexpected trailing input");
+    }
+    return true;
+}
+
+ExprInputs expression_inputs(const Canvas& canvas, const std::vector<Cell>& cells) {
+    ExprInputs inputs;
+    for (auto& var : inputs.vars) {
+        var.reserve(cells.size());
+    }
+    inputs.ids.reserve(cells.size());
+
+    // u, v from the actual center, so jitter and Poisson placement show up
+    double width = canvas.width > 0 ? canvas.width : 1;
+    double height = canvas.height > 0 ? canvas.height : 1;
+    for (const auto& cell : cells) {
+        inputs.ids.push_back(cell.id);
+        inputs.vars[VarRow].push_back(cell.row);
+        inputs.vars[VarCol].push_back(cell.col);
+        inputs.vars[VarIndex].push_back(cell.id);
+        inputs.vars[VarU].push_back(cell.center.x / width);
+        inputs.vars[VarV].push_back(cell.center.y / height);
+        inputs.vars[VarX].push_back(cell.center.x);
+        inputs.vars[VarY].push_back(cell.center.y);
+    }
+    return inputs;
+}
+
+void evaluate_expression(const Expression& expr, const ExprInputs& inputs, uint64_t seed, std::vector<double>& out) {
+    size_t n = inputs.size();
+    out.resize(n);
+    if (expr.code.empty()) {
+        std::fill(out.begin(), out.end(), 0.0);
+        return;
+    }
+
+    std::vector<double> stack((size_t)expr.maxStack * kBatch);
+    for (size_t base = 0; base < n; base += kBatch) {
+        size_t len = std::min(kBatch, n - base);
+        int sp = 0;
+
+        for (const auto& ins : expr.code) {
+            // Binary ops combine b (left operand) and a (right operand, top of
+            // the stack) into b; unary ops work in place on a. top is the next
+            // free slot, one past the end at full depth, so only pushes use it
+            double* top = stack.data() + (size_t)sp * kBatch;
+            double* a = sp >= 1 ? top - kBatch : nullptr;
+            double* b = sp >= 2 ? top - 2 * kBatch : nullptr;
+
+            switch (ins.op) {
+            case ExprOp::Const: op_fill(top, expr.constants[ins.arg]); ++sp; break;
+            case ExprOp::Var: op_load(top, inputs.vars[ins.arg].data() + base, len); ++sp; break;
+            case ExprOp::Add: op_add(b, a); --sp; break;
+            case ExprOp::Sub: op_sub(b, a); --sp; break;
+            case ExprOp::Mul: op_mul(b, a); --sp; break;
+            case ExprOp::Div: op_div(b, a); --sp; break;
+            case ExprOp::Min: op_min(b, a); --sp; break;
+            case ExprOp::Max: op_max(b, a); --sp; break;
+            case ExprOp::Pow: for (size_t i = 0; i < len; ++i) b[i] = std::pow(b[i], a[i]); --sp; break;
+            case ExprOp::Noise: for (size_t i = 0; i < len; ++i) b[i] = value_noise(b[i], a[i], seed); --sp; break;
+            case ExprOp::Neg: op_neg(a); break;
+            case ExprOp::Abs: op_abs(a); break;
+            case ExprOp::Sqrt: op_sqrt(a); break;
+            case ExprOp::Floor: op_floor(a); break;
+            case ExprOp::Sin: for (size_t i = 0; i < len; ++i) a[i] = std::sin(a[i]); break;
+            case ExprOp::Cos: for (size_t i = 0; i < len; ++i) a[i] = std::cos(a[i]); break;
+            case ExprOp::Rand: {
+                // Keyed by cell and call site, so values do not depend on batching or sharding
+                uint64_t site = cell_seed(seed, -1, ins.arg);
+                for (size_t i = 0; i < len; ++i) {
+                    top[i] = hash_unit(cell_seed(site, -1, inputs.ids[base + i]));
+                }
+                std::fill(top + len, top + kBatch, 0.0);
+                ++sp;
+                break;
+            }
+            }
+        }
+
+        std::copy(stack.begin(), stack.begin() + len, out.begin() + base);
+    }
+}
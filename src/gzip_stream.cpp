@@ -0,0 +1,490 @@
+#include "gzip_stream.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+#ifdef ALMIGHTY_ZLIB
+#include <zlib.h>
+#endif
+
+uint32_t crc32_update(uint32_t crc, const uint8_t* data, size_t size) {
+    static const struct Table {
+        uint32_t entries[256];
+        Table() {
+            for (uint32_t n = 0; n < 256; ++n) {
+                uint32_t c = n;
+                for (int k = 0; k < 8; ++k) {
+                    c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                }
+                entries[n] = c;
+            }
+        }
+    } table;
+
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i) {
+        crc = table.entries[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+namespace {
+
+const size_t kWindowSize = 32768;
+const int kMinMatch = 3;
+const int kMaxMatch = 258;
+
+// Fixed Huffman codes (RFC 1951, 3.2.6), bit-reversed for LSB-first output,
+// and the length/distance code tables
+struct DeflateTables {
+    uint16_t literalCode[288];
+    uint8_t literalBits[288];
+    uint8_t distanceCode[30];
+
+    uint16_t lengthBase[29];
+    uint8_t lengthExtra[29];
+    uint8_t lengthSymbol[kMaxMatch + 1];  // length -> index into lengthBase
+    uint16_t distanceBase[30];
+    uint8_t distanceExtra[30];
+
+    static uint16_t reverse(uint16_t code, int bits) {
+        uint16_t r = 0;
+        for (int k = 0; k < bits; ++k) {
+            r = (uint16_t)((r << 1) | ((code >> k) & 1));
+        }
+        return r;
+    }
+
+    DeflateTables() {
+        for (int s = 0; s < 288; ++s) {
+            int code, bits;
+            if (s < 144) {
+                code = 0x30 + s, bits = 8;
+            } else if (s < 256) {
+                code = 0x190 + s - 144, bits = 9;
+            } else if (s < 280) {
+                code = s - 256, bits = 7;
+            } else {
+                code = 0xC0 + s - 280, bits = 8;
+            }
+            literalCode[s] = reverse((uint16_t)code, bits);
+            literalBits[s] = (uint8_t)bits;
+        }
+        for (int d = 0; d < 30; ++d) {
+            distanceCode[d] = reverse((uint16_t)d, 5);
+        }
+
+        int length = 3;
+        for (int k = 0; k < 28; ++k) {
+            lengthExtra[k] = (uint8_t)(k < 8 ? 0 : (k - 4) / 4);
+            lengthBase[k] = (uint16_t)length;
+            for (int n = 0; n < (1 << lengthExtra[k]); ++n) {
+                lengthSymbol[length++] = (uint8_t)k;
+            }
+        }
+        // 258 has its own code without extra bits
+        lengthBase[28] = 258;
+        lengthExtra[28] = 0;
+        lengthSymbol[258] = 28;
+
+        int distance = 1;
+        for (int k = 0; k < 30; ++k) {
+            distanceExtra[k] = (uint8_t)(k < 4 ? 0 : (k - 2) / 2);
+            distanceBase[k] = (uint16_t)distance;
+            distance += 1 << distanceExtra[k];
+        }
+    }
+
+    int distance_symbol(int distance) const {
+        return (int)(std::upper_bound(distanceBase, distanceBase + 30, distance) - distanceBase) - 1;
+    }
+};
+
+const DeflateTables& deflate_tables() {
+    static const DeflateTables tables;
+    return tables;
+}
+
+// LSB-first bit packing into a byte string
+struct BitWriter {
+    std::string& out;
+    uint64_t bits = 0;
+    int count = 0;
+
+    explicit BitWriter(std::string& target) : out(target) {}
+
+    void put(uint32_t value, int n) {
+        bits |= (uint64_t)value << count;
+        count += n;
+        while (count >= 8) {
+            out.push_back((char)(bits & 0xFF));
+            bits >>= 8;
+            count -= 8;
+        }
+    }
+};
+
+// Built-in gzip encoder: greedy LZ77 over a 32 KiB window with hash chains,
+// one fixed-Huffman block per buffer. Level 0 writes stored blocks.
+struct BuiltinDeflater : Deflater {
+    explicit BuiltinDeflater(int level) : level(std::max(0, std::min(9, level))) {
+        // Hash chain search depth and "good enough" match length per level
+        static const int chains[10] = {0, 4, 6, 8, 16, 32, 128, 256, 1024, 4096};
+        static const int nice[10] = {0, 8, 16, 32, 32, 64, 128, 128, 258, 258};
+        maxChain = chains[this->level];
+        niceLength = nice[this->level];
+        head.assign(kHashSize, -1);
+    }
+
+    bool compress(const uint8_t* data, size_t size, bool last, std::string& out) override {
+        if (!headerWritten) {
+            const char header[10] = {
+                (char)0x1F, (char)0x8B, 8, 0, 0, 0, 0, 0, (char)(level == 9 ? 2 : (level == 1 ? 4 : 0)), (char)0xFF
+            };
+            out.append(header, sizeof(header));
+            headerWritten = true;
+        }
+        crc = crc32_update(crc, data, size);
+        inputSize += (uint32_t)size;
+
+        if (level == 0) {
+            store(data, size, last, out);
+        } else {
+            deflate_block(data, size, last, out);
+        }
+
+        if (last) {
+            // Bytes are already aligned: the final block ends with a flush
+            for (int k = 0; k < 4; ++k) {
+                out.push_back((char)((crc >> (8 * k)) & 0xFF));
+            }
+            for (int k = 0; k < 4; ++k) {
+                out.push_back((char)((inputSize >> (8 * k)) & 0xFF));
+            }
+        }
+        return true;
+    }
+
+private:
+    static const size_t kHashSize = 1 << 15;
+
+    static size_t hash(const uint8_t* p) {
+        return ((p[0] << 10) ^ (p[1] << 5) ^ p[2]) & (kHashSize - 1);
+    }
+
+    void store(const uint8_t* data, size_t size, bool last, std::string& out) {
+        do {
+            size_t n = std::min<size_t>(size, 65535);
+            bool final = last && n == size;
+            out.push_back(final ? 1 : 0);
+            out.push_back((char)(n & 0xFF));
+            out.push_back((char)(n >> 8));
+            out.push_back((char)(~n & 0xFF));
+            out.push_back((char)((~n >> 8) & 0xFF));
+            out.append((const char*)data, n);
+            data += n;
+            size -= n;
+        } while (size > 0);
+    }
+
+    void insert(size_t i) {
+        size_t h = hash(&window[i]);
+        prev[i] = head[h];
+        head[h] = (int32_t)i;
+    }
+
+    void deflate_block(const uint8_t* data, size_t size, bool last, std::string& out) {
+        const DeflateTables& tables = deflate_tables();
+        size_t start = window.size();
+        window.insert(window.end(), data, data + size);
+        prev.resize(window.size(), -1);
+        size_t end = window.size();
+
+        BitWriter writer(out);
+        writer.bits = pendingBits;
+        writer.count = pendingCount;
+        writer.put(last ? 1 : 0, 1);
+        writer.put(1, 2);  // fixed Huffman codes
+
+        size_t i = start;
+        while (i < end) {
+            int bestLength = 0;
+            size_t bestDistance = 0;
+            if (i + kMinMatch <= end) {
+                size_t maxLength = std::min<size_t>(kMaxMatch, end - i);
+                int32_t candidate = head[hash(&window[i])];
+                int chain = maxChain;
+                while (candidate >= 0 && i - candidate <= kWindowSize && chain-- > 0) {
+                    const uint8_t* a = &window[candidate];
+                    const uint8_t* b = &window[i];
+                    if (a[bestLength] == b[bestLength] && a[0] == b[0]) {
+                        size_t length = 1;
+                        while (length < maxLength && a[length] == b[length]) {
+                            ++length;
+                        }
+                        if ((int)length > bestLength) {
+                            bestLength = (int)length;
+                            bestDistance = i - candidate;
+                            if (bestLength >= niceLength || length == maxLength) {
+                                break;
+                            }
+                        }
+                    }
+                    candidate = prev[candidate];
+                }
+                insert(i);
+            }
+
+            if (bestLength >= kMinMatch) {
+                int l = tables.lengthSymbol[bestLength];
+                writer.put(tables.literalCode[257 + l], tables.literalBits[257 + l]);
+                writer.put(bestLength - tables.lengthBase[l], tables.lengthExtra[l]);
+                int d = tables.distance_symbol((int)bestDistance);
+                writer.put(tables.distanceCode[d], 5);
+                writer.put((uint32_t)(bestDistance - tables.distanceBase[d]), tables.distanceExtra[d]);
+
+                for (size_t k = i + 1; k < i + bestLength && k + kMinMatch <= end; ++k) {
+                    insert(k);
+                }
+                i += bestLength;
+            } else {
+                writer.put(tables.literalCode[window[i]], tables.literalBits[window[i]]);
+                ++i;
+            }
+        }
+        writer.put(tables.literalCode[256], tables.literalBits[256]);
+
+        if (last && writer.count > 0) {
+            writer.put(0, 8 - writer.count);
+        }
+        pendingBits = writer.bits;
+        pendingCount = writer.count;
+
+        slide();
+    }
+
+    // Keep only the last 32 KiB as history for the next buffer
+    void slide() {
+        if (window.size() <= kWindowSize) {
+            return;
+        }
+        size_t shift = window.size() - kWindowSize;
+        window.erase(window.begin(), window.begin() + shift);
+        prev.erase(prev.begin(), prev.begin() + shift);
+        auto rebase = [shift](int32_t& position) {
+            position = position >= (int32_t)shift ? position - (int32_t)shift : -1;
+        };
+        std::for_each(head.begin(), head.end(), rebase);
+        std::for_each(prev.begin(), prev.end(), rebase);
+    }
+
+    int level;
+    int maxChain = 0;
+    int niceLength = 0;
+    bool headerWritten = false;
+    uint32_t crc = 0;
+    uint32_t inputSize = 0;
+    uint64_t pendingBits = 0;  // bits of an unfinished byte between blocks
+    int pendingCount = 0;
+
+    std::vector<uint8_t> window;
+    std::vector<int32_t> head;
+    std::vector<int32_t> prev;
+};
+
+#ifdef ALMIGHTY_ZLIB
+struct ZlibDeflater : Deflater {
+    explicit ZlibDeflater(int level) {
+        // 15 + 16: 32 KiB window with a gzip header and trailer
+        initialized = deflateInit2(&stream, std::max(0, std::min(9, level)), Z_DEFLATED, 15 + 16, 8,
+                                   Z_DEFAULT_STRATEGY) == Z_OK;
+    }
+    ~ZlibDeflater() override {
+        if (initialized) {
+            deflateEnd(&stream);
+        }
+    }
+
+    bool compress(const uint8_t* data, size_t size, bool last, std::string& out) override {
+        stream.next_in = const_cast<Bytef*>(data);
+        stream.avail_in = (uInt)size;
+        unsigned char chunk[16384];
+        int status;
+        do {
+            stream.next_out = chunk;
+            stream.avail_out = sizeof(chunk);
+            status = deflate(&stream, last ? Z_FINISH : Z_NO_FLUSH);
+            if (status == Z_STREAM_ERROR) {
+                return false;
+            }
+            out.append((const char*)chunk, sizeof(chunk) - stream.avail_out);
+        } while (stream.avail_out == 0 || (last && status == Z_OK));
+        return !last || status == Z_STREAM_END;
+    }
+
+    z_stream stream{};
+    bool initialized = false;
+};
+#endif
+
+} // namespace
+
+std::unique_ptr<Deflater> make_deflater(int level) {
+#ifdef ALMIGHTY_ZLIB
+    std::unique_ptr<ZlibDeflater> deflater(new ZlibDeflater(level));
+    if (!deflater->initialized) {
+        return nullptr;
+    }
+    return deflater;
+#else
+    return std::unique_ptr<Deflater>(new BuiltinDeflater(level));
+#endif
+}
+
+GzipStreamBuf::GzipStreamBuf(std::ostream& sink, const GzipOptions& options)
+    : sink(sink), options(options), deflater(make_deflater(options.level)) {
+    this->options.bufferSize = std::max<size_t>(options.bufferSize, 1024);
+    buffer.resize(this->options.bufferSize);
+    setp(buffer.data(), buffer.data() + buffer.size());
+    if (!deflater) {
+        failed = true;
+    } else if (options.thread) {
+        thread = std::thread(&GzipStreamBuf::worker, this);
+    }
+}
+
+GzipStreamBuf::~GzipStreamBuf() {
+    finish();
+}
+
+GzipStreamBuf::int_type GzipStreamBuf::overflow(int_type c) {
+    if (finished) {
+        return traits_type::eof();
+    }
+    submit(false);
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+    }
+    return failed ? traits_type::eof() : traits_type::not_eof(c);
+}
+
+int GzipStreamBuf::sync() {
+    return failed ? -1 : 0;
+}
+
+bool GzipStreamBuf::finish() {
+    if (finished) {
+        return !failed;
+    }
+    submit(true);
+    if (thread.joinable()) {
+        thread.join();
+    }
+    finished = true;
+    setp(nullptr, nullptr);
+    sink.flush();
+    if (!sink) {
+        failed = true;
+    }
+    return !failed;
+}
+
+void GzipStreamBuf::submit(bool last) {
+    size_t size = pptr() - pbase();
+    if (!thread.joinable()) {
+        compress_data(buffer.data(), size, last);
+        setp(buffer.data(), buffer.data() + buffer.size());
+        return;
+    }
+
+    // A few buffers in flight let the renderer run ahead of the compressor
+    buffer.resize(size);
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [this]() { return queue.size() < 4; });
+    queue.push_back(std::move(buffer));
+    lastQueued = last;
+    if (!spare.empty()) {
+        buffer = std::move(spare.back());
+        spare.pop_back();
+    } else {
+        buffer = std::vector<char>();
+    }
+    changed.notify_all();
+    lock.unlock();
+
+    buffer.resize(options.bufferSize);
+    setp(buffer.data(), buffer.data() + buffer.size());
+}
+
+void GzipStreamBuf::compress_data(const char* data, size_t size, bool last) {
+    if (failed) {
+        return;
+    }
+    if (!deflater->compress((const uint8_t*)data, size, last, compressed)) {
+        failed = true;
+    }
+    if (!compressed.empty()) {
+        sink.write(compressed.data(), compressed.size());
+        compressed.clear();
+    }
+    if (!sink) {
+        failed = true;
+    }
+}
+
+void GzipStreamBuf::worker() {
+    for (;;) {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this]() { return !queue.empty(); });
+        std::vector<char> item = std::move(queue.front());
+        queue.erase(queue.begin());
+        bool last = lastQueued && queue.empty();
+        lock.unlock();
+
+        compress_data(item.data(), item.size(), last);
+
+        lock.lock();
+        spare.push_back(std::move(item));
+        changed.notify_all();
+        if (last) {
+            return;
+        }
+    }
+}
+
+GzipOStream::GzipOStream(std::ostream& sink, const GzipOptions& options)
+    : std::ostream(nullptr), buf(sink, options) {
+    rdbuf(&buf);
+    if (!buf.ok()) {
+        setstate(std::ios::badbit);
+    }
+}
+
+bool is_gzip_path(const std::string& path) {
+    auto ends_with = [&](const std::string& suffix) {
+        return path.size() >= suffix.size() && path.compare(path.size() - suffix.size(), suffix.size(), suffix) == 0;
+    };
+    return ends_with(".svgz") || ends_with(".gz");
+}
+
+bool write_gzip_file(
+    const std::string& path,
+    const std::function<void(std::ostream&)>& writer,
+    const GzipOptions& options
+) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Error: Unable to open " << path << std::endl;
+        return false;
+    }
+    GzipOStream out(file, options);
+    writer(out);
+    bool ok = out.finish() && (bool)out;
+    file.close();
+    if (!ok || !file) {
+        std::cerr << "Error: Unable to write " << path << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,250 @@
+#include "layout.hpp"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <random>
+
+uint64_t cell_seed(uint64_t seed, int row, int col) {
+    // splitmix64 over (seed, row, col)
+    uint64_t z = seed + 0x9E3779B97F4A7C15ULL * (((uint64_t)(uint32_t)row << 32) | (uint32_t)col);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+uint64_t cell_seed(uint64_t seed, const Cell& cell) {
+    return cell_seed(seed, -1, cell.id);
+}
+
+uint64_t resolve_seed(uint64_t seed) {
+    if (seed != 0) {
+        return seed;
+    }
+    std::random_device rd;
+    return ((uint64_t)rd() << 32) | rd();
+}
+
+// Clamp [rowBegin, rowEnd) to the canvas rows
+static void clamp_rows(const Canvas& canvas, int& rowBegin, int& rowEnd) {
+    if (rowEnd < 0 || rowEnd > canvas.rows) {
+        rowEnd = canvas.rows;
+    }
+    rowBegin = std::clamp(rowBegin, 0, std::max(rowEnd, 0));
+}
+
+std::vector<Cell> grid_layout(const Canvas& canvas, int rowBegin, int rowEnd) {
+    clamp_rows(canvas, rowBegin, rowEnd);
+    std::vector<Cell> cells;
+    cells.reserve((size_t)(rowEnd - rowBegin) * std::max(canvas.cols, 0));
+
+    double spacingX = canvas.width / (canvas.cols + 1);
+    double spacingY = canvas.height / (canvas.rows + 1);
+
+    for (int i = rowBegin; i < rowEnd; ++i) {
+        for (int j = 0; j < canvas.cols; ++j) {
+            cells.push_back({i, j, {(j + 1) * spacingX, (i + 1) * spacingY}, i * canvas.cols + j});
+        }
+    }
+    return cells;
+}
+
+std::vector<Cell> hex_layout(const Canvas& canvas, int rowBegin, int rowEnd) {
+    clamp_rows(canvas, rowBegin, rowEnd);
+    std::vector<Cell> cells;
+    cells.reserve((size_t)(rowEnd - rowBegin) * std::max(canvas.cols, 0));
+
+    // Largest regular hex pitch that fits the grid, odd rows shifted half a column
+    double pitchX = std::min(canvas.width / (canvas.cols + 1.0),
+                             canvas.height / (canvas.rows + 1.0) * 2.0 / std::sqrt(3.0));
+    double pitchY = pitchX * std::sqrt(3.0) / 2.0;
+    double originX = (canvas.width - (canvas.cols - 0.5) * pitchX) / 2.0;
+    double originY = (canvas.height - (canvas.rows - 1) * pitchY) / 2.0;
+
+    for (int i = rowBegin; i < rowEnd; ++i) {
+        double shift = (i % 2 == 1) ? pitchX / 2.0 : 0.0;
+        for (int j = 0; j < canvas.cols; ++j) {
+            cells.push_back({i, j, {originX + j * pitchX + shift, originY + i * pitchY}, i * canvas.cols + j});
+        }
+    }
+    return cells;
+}
+
+std::vector<Cell> jittered_layout(const Canvas& canvas, double jitter, uint64_t seed, int rowBegin, int rowEnd) {
+    std::vector<Cell> cells = grid_layout(canvas, rowBegin, rowEnd);
+    seed = resolve_seed(seed);
+
+    double maxX = jitter * (canvas.width / (canvas.cols + 1.0)) / 2.0;
+    double maxY = jitter * (canvas.height / (canvas.rows + 1.0)) / 2.0;
+
+    for (auto& cell : cells) {
+        // Hash bits mapped to [-1, 1): seeding an engine per cell would dominate the cost
+        uint64_t hx = cell_seed(seed, cell.row, cell.col);
+        uint64_t hy = cell_seed(hx, cell.row, cell.col);
+        cell.center.x += ((hx >> 11) * 0x1.0p-52 - 1.0) * maxX;
+        cell.center.y += ((hy >> 11) * 0x1.0p-52 - 1.0) * maxY;
+    }
+    return cells;
+}
+
+// Bridson's algorithm: the hash cell is r/sqrt(2) wide, so rejection tests
+// only touch a constant number of buckets and generation stays O(N).
+std::vector<Cell> poisson_layout(const Canvas& canvas, double minDistance, int maxAttempts, uint64_t seed) {
+    std::vector<Cell> cells;
+    if (canvas.rows <= 0 || canvas.cols <= 0) {
+        return cells;
+    }
+
+    double spacingX = canvas.width / (canvas.cols + 1.0);
+    double spacingY = canvas.height / (canvas.rows + 1.0);
+    double r = minDistance > 0 ? minDistance : std::min(spacingX, spacingY);
+
+    // Sample the area covered by the grid cells
+    double x0 = spacingX / 2.0;
+    double y0 = spacingY / 2.0;
+    double w = canvas.width - spacingX;
+    double h = canvas.height - spacingY;
+    if (w <= 0 || h <= 0) {
+        return cells;
+    }
+
+    std::mt19937_64 gen(resolve_seed(seed));
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+
+    SpatialHash hash(w, h, r / std::sqrt(2.0));
+    std::vector<int> active;
+
+    active.push_back(hash.insert({unit(gen) * w, unit(gen) * h}));
+    while (!active.empty()) {
+        size_t k = (size_t)(unit(gen) * active.size()) % active.size();
+        Point p = hash.points[active[k]];
+
+        bool placed = false;
+        for (int attempt = 0; attempt < maxAttempts; ++attempt) {
+            // Uniform in the annulus [r, 2r]
+            double angle = unit(gen) * 2.0 * M_PI;
+            double radius = r * std::sqrt(1.0 + 3.0 * unit(gen));
+            Point q{p.x + radius * std::cos(angle), p.y + radius * std::sin(angle)};
+
+            if (q.x < 0 || q.y < 0 || q.x >= w || q.y >= h || hash.any_within(q, r)) {
+                continue;
+            }
+            active.push_back(hash.insert(q));
+            placed = true;
+            break;
+        }
+        if (!placed) {
+            active[k] = active.back();
+            active.pop_back();
+        }
+    }
+
+    // Assign the nearest grid row/col, then counting-sort by row
+    std::vector<int> rowCount(canvas.rows + 1, 0);
+    std::vector<Cell> unsorted;
+    unsorted.reserve(hash.points.size());
+    for (const auto& p : hash.points) {
+        Point c{x0 + p.x, y0 + p.y};
+        int row = std::clamp((int)std::lround(c.y / spacingY) - 1, 0, canvas.rows - 1);
+        int col = std::clamp((int)std::lround(c.x / spacingX) - 1, 0, canvas.cols - 1);
+        unsorted.push_back({row, col, c, 0});
+        ++rowCount[row + 1];
+    }
+    for (int i = 0; i < canvas.rows; ++i) {
+        rowCount[i + 1] += rowCount[i];
+    }
+    cells.resize(unsorted.size());
+    for (const auto& cell : unsorted) {
+        cells[rowCount[cell.row]++] = cell;
+    }
+
+    // Within a row, order by x
+    auto begin = cells.begin();
+    while (begin != cells.end()) {
+        auto end = std::find_if(begin, cells.end(), [&](const Cell& c) { return c.row != begin->row; });
+        std::sort(begin, end, [](const Cell& a, const Cell& b) { return a.center.x < b.center.x; });
+        begin = end;
+    }
+    for (size_t k = 0; k < cells.size(); ++k) {
+        cells[k].id = (int)k;
+    }
+    return cells;
+}
+
+std::vector<Cell> cells_in_rows(const std::vector<Cell>& cells, int rowBegin, int rowEnd) {
+    if (rowEnd < 0) {
+        rowEnd = INT_MAX;
+    }
+    auto first = std::lower_bound(cells.begin(), cells.end(), rowBegin,
+                                  [](const Cell& c, int row) { return c.row < row; });
+    auto last = std::lower_bound(first, cells.end(), rowEnd,
+                                 [](const Cell& c, int row) { return c.row < row; });
+    return std::vector<Cell>(first, last);
+}
+
+std::vector<Cell> layout_cells(const Canvas& canvas, const Layout& layout, int rowBegin, int rowEnd) {
+    if (layout.type == "hex") {
+        return hex_layout(canvas, rowBegin, rowEnd);
+    } else if (layout.type == "jittered") {
+        return jittered_layout(canvas, layout.jitter, layout.seed, rowBegin, rowEnd);
+    } else if (layout.type == "poisson") {
+        // Poisson samples depend on each other: generate everything, keep the band
+        clamp_rows(canvas, rowBegin, rowEnd);
+        return cells_in_rows(poisson_layout(canvas, layout.minDistance, layout.maxAttempts, layout.seed),
+                             rowBegin, rowEnd);
+    }
+    return grid_layout(canvas, rowBegin, rowEnd);
+}
+
+SpatialHash::SpatialHash(double width, double height, double cellSize) : cellSize(cellSize) {
+    gridW = std::max(1, (int)std::ceil(width / cellSize));
+    gridH = std::max(1, (int)std::ceil(height / cellSize));
+    head.assign((size_t)gridW * gridH, -1);
+}
+
+int SpatialHash::bucket_x(double x) const {
+    return std::clamp((int)std::floor(x / cellSize), 0, gridW - 1);
+}
+
+int SpatialHash::bucket_y(double y) const {
+    return std::clamp((int)std::floor(y / cellSize), 0, gridH - 1);
+}
+
+int SpatialHash::insert(Point p) {
+    int id = (int)points.size();
+    size_t b = (size_t)bucket_y(p.y) * gridW + bucket_x(p.x);
+    points.push_back(p);
+    next.push_back(head[b]);
+    head[b] = id;
+    return id;
+}
+
+bool SpatialHash::any_within(Point p, double radius) const {
+    double r2 = radius * radius;
+    for (int by = bucket_y(p.y - radius); by <= bucket_y(p.y + radius); ++by) {
+        for (int bx = bucket_x(p.x - radius); bx <= bucket_x(p.x + radius); ++bx) {
+            for (int id = head[(size_t)by * gridW + bx]; id != -1; id = next[id]) {
+                double dx = points[id].x - p.x;
+                double dy = points[id].y - p.y;
+                if (dx * dx + dy * dy < r2) {
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+void SpatialHash::query(Point p, double radius, std::vector<int>& out) const {
+    double r2 = radius * radius;
+    for (int by = bucket_y(p.y - radius); by <= bucket_y(p.y + radius); ++by) {
+        for (int bx = bucket_x(p.x - radius); bx <= bucket_x(p.x + radius); ++bx) {
+            for (int id = head[(size_t)by * gridW + bx]; id != -1; id = next[id]) {
+                double dx = points[id].x - p.x;
+                double dy = points[id].y - p.y;
+                if (dx * dx + dy * dy < r2) {
+                    out.push_back(id);
+                }
+            }
+        }
+    }
+}
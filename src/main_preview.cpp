@@ -0,0 +1,69 @@
+#include "geometry.hpp"
+#include "preview_server.hpp"
+#include "svg_utils.hpp"
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+// Local preview server:
+//   main_preview [port]
+// then open http://127.0.0.1:<port>/ and pick a scene; add ?seed=N to the
+// scene URL to render a given seed.
+
+static PreviewServer* g_server = nullptr;
+
+static void handle_signal(int) {
+    if (g_server) {
+        g_server->stop();
+    }
+}
+
+Canvas create_canvas(int rows, int cols) {
+    Object square;
+    square.points = {{-20, -20}, {20, -20}, {20, 20}, {-20, 20}};
+    square.color = "blue";
+
+    Canvas canvas;
+    canvas.width = cols * 50;
+    canvas.height = rows * 50;
+    canvas.baseObject = {square};
+    canvas.rows = rows;
+    canvas.cols = cols;
+    return canvas;
+}
+
+int main(int argc, char** argv) {
+    PreviewServerConfig config;
+    if (argc > 1) {
+        config.port = std::atoi(argv[1]);
+    }
+    PreviewServer server(config);
+
+    PreviewScene random;
+    random.canvas = create_canvas(20, 30);
+    std::vector<Transform> transforms = {{"rotate", 45}, {"scale", 0.8}};
+    random.renderer = [canvas = random.canvas, transforms](std::ostream& out, const RenderOptions& options) {
+        canvas_list_transform_simpleObject_write(out, canvas, transforms, -1, options);
+    };
+    server.add_scene("random", random);
+
+    PreviewScene waves;
+    waves.canvas = create_canvas(400, 400);
+    waves.renderer = [canvas = waves.canvas](std::ostream& out, const RenderOptions& options) {
+        canvas_expression_transform_composed_write(out, canvas, {{"rotate", "90 * noise(u * 4, v * 4)"}}, options);
+    };
+    waves.options.layout.type = "hex";
+    server.add_scene("waves", waves);
+
+    if (!server.start()) {
+        return 1;
+    }
+    g_server = &server;
+    std::signal(SIGINT, handle_signal);
+    std::signal(SIGTERM, handle_signal);
+
+    std::cout << "Preview server on http://" << config.host << ":" << server.port() << "/" << std::endl;
+    server.run();
+    return 0;
+}
@@ -0,0 +1,74 @@
+#include "geometry.hpp"
+#include "shard.hpp"
+#include "svg_utils.hpp"
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Sharded rendering driver. Each node renders its own band of rows with the
+// same shard count and seeds, then one node merges the shard files:
+//   main_shard render <shard> <shards> <seed> <layout-seed> <dir>
+//   main_shard merge <shards> <dir> <output.svg>
+//   main_shard local <shards> <workers> <seed> <dir> <output.svg>
+
+Canvas create_canvas() {
+    Object square;
+    square.points = {{-20, -20}, {20, -20}, {20, 20}, {-20, 20}};
+    square.color = "blue";
+
+    Canvas canvas;
+    canvas.width = 8000;
+    canvas.height = 6000;
+    canvas.baseObject = {square};
+    canvas.rows = 150;
+    canvas.cols = 200;
+    return canvas;
+}
+
+int main(int argc, char** argv) {
+    Canvas canvas = create_canvas();
+    std::vector<Transform> transforms = {
+        {"rotate", 45},
+        {"scale", 0.8}
+    };
+    ShardRenderer renderer = [&](std::ostream& out, const RenderOptions& options) {
+        canvas_list_transform_simpleObject_write(out, canvas, transforms, -1, options);
+    };
+
+    std::string mode = argc > 1 ? argv[1] : "";
+    if (mode == "render" && argc == 7) {
+        // Every node must use the same seeds, so a random one (0) cannot be
+        // picked here
+        RenderOptions options;
+        options.seed = std::strtoull(argv[4], nullptr, 10);
+        options.layout.seed = std::strtoull(argv[5], nullptr, 10);
+        if (options.seed == 0 || options.layout.seed == 0) {
+            std::cerr << "Error: Render mode needs nonzero seeds shared by every node" << std::endl;
+            return 1;
+        }
+        std::vector<Shard> shards = plan_shards(canvas, std::atoi(argv[3]), argv[6]);
+        int k = std::atoi(argv[2]);
+        if (k < 0 || k >= (int)shards.size()) {
+            std::cerr << "Error: Shard index out of range" << std::endl;
+            return 1;
+        }
+        return render_shard(shards[k], renderer, options) ? 0 : 1;
+    } else if (mode == "merge" && argc == 5) {
+        std::vector<Shard> shards = plan_shards(canvas, std::atoi(argv[2]), argv[3]);
+        return merge_svg_shards(canvas, shards, std::string(argv[4])) ? 0 : 1;
+    } else if (mode == "local" && argc == 7) {
+        RenderOptions options;
+        options.seed = std::strtoull(argv[4], nullptr, 10);
+        bool ok = render_sharded(canvas, renderer, options, std::atoi(argv[2]), std::atoi(argv[3]), argv[5], argv[6]);
+        if (ok) {
+            std::cout << "Sharded render saved as '" << argv[6] << "'" << std::endl;
+        }
+        return ok ? 0 : 1;
+    }
+
+    std::cerr << "Usage: " << argv[0] << " render <shard> <shards> <seed> <layout-seed> <dir>\n"
+              << "       " << argv[0] << " merge <shards> <dir> <output.svg>\n"
+              << "       " << argv[0] << " local <shards> <workers> <seed> <dir> <output.svg>" << std::endl;
+    return 1;
+}
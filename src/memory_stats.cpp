@@ -0,0 +1,241 @@
+#include "memory_stats.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <sstream>
+
+namespace {
+
+std::atomic<uint64_t> g_allocations{0};
+std::atomic<uint64_t> g_bytes{0};
+std::atomic<uint64_t> g_live{0};
+std::atomic<uint64_t> g_peak{0};
+
+RenderMemoryReport g_last;
+
+} // namespace
+
+const MemoryStats* RenderMemoryReport::stage(const char* name) const {
+    for (int i = 0; i < stageCount; ++i) {
+        if (std::strcmp(stages[i].name, name) == 0) {
+            return &stages[i].stats;
+        }
+    }
+    return nullptr;
+}
+
+double RenderMemoryReport::allocations_per_cell() const {
+    return cells ? (double)total.allocations / cells : 0.0;
+}
+
+double RenderMemoryReport::allocations_per_vertex() const {
+    return vertices ? (double)total.allocations / vertices : 0.0;
+}
+
+double RenderMemoryReport::bytes_per_vertex() const {
+    return vertices ? (double)total.bytes / vertices : 0.0;
+}
+
+bool memory_tracking_enabled() {
+#ifdef ALMIGHTY_MEMORY_TRACKING
+    return true;
+#else
+    return false;
+#endif
+}
+
+uint64_t memory_live_bytes() {
+    return g_live.load(std::memory_order_relaxed);
+}
+
+const RenderMemoryReport& memory_last_report() {
+    return g_last;
+}
+
+std::string memory_report_to_string(const RenderMemoryReport& report) {
+    std::ostringstream out;
+    out << report.call << ": " << report.total.allocations << " allocations, "
+        << report.total.bytes << " bytes, peak " << report.total.peakLiveBytes << " live bytes\n";
+    out << "  " << report.cells << " cells, " << report.vertices << " vertices, "
+        << report.allocations_per_cell() << " allocations/cell, "
+        << report.allocations_per_vertex() << " allocations/vertex, "
+        << report.bytes_per_vertex() << " bytes/vertex\n";
+    for (int i = 0; i < report.stageCount; ++i) {
+        const MemoryStats& stats = report.stages[i].stats;
+        out << "  " << report.stages[i].name << ": " << stats.allocations << " allocations, "
+            << stats.bytes << " bytes, peak " << stats.peakLiveBytes << " live bytes\n";
+    }
+    return out.str();
+}
+
+#ifdef ALMIGHTY_MEMORY_TRACKING
+
+namespace {
+
+RenderMemoryReport g_current;
+int g_depth = 0;
+
+// Peak tracking is reset at the start of each scope and merged back at the
+// end, so nested scopes (render call > stage) each see their own peak.
+uint64_t begin_peak() {
+    uint64_t saved = g_peak.load(std::memory_order_relaxed);
+    g_peak.store(g_live.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    return saved;
+}
+
+uint64_t end_peak(uint64_t liveAtStart, uint64_t savedPeak) {
+    uint64_t peak = g_peak.load(std::memory_order_relaxed);
+    if (savedPeak > peak) {
+        g_peak.store(savedPeak, std::memory_order_relaxed);
+    }
+    return peak > liveAtStart ? peak - liveAtStart : 0;
+}
+
+void record_alloc(size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    g_bytes.fetch_add(size, std::memory_order_relaxed);
+    uint64_t live = g_live.fetch_add(size, std::memory_order_relaxed) + size;
+    uint64_t peak = g_peak.load(std::memory_order_relaxed);
+    while (live > peak && !g_peak.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+    }
+}
+
+void record_free(size_t size) {
+    g_live.fetch_sub(size, std::memory_order_relaxed);
+}
+
+// The requested size is stored just before the returned pointer
+void* tracked_alloc(size_t size, size_t align) {
+    if (align < alignof(std::max_align_t)) {
+        align = alignof(std::max_align_t);
+    }
+    size_t total = (size + align + align - 1) / align * align;
+    void* base = align == alignof(std::max_align_t) ? std::malloc(total) : std::aligned_alloc(align, total);
+    if (base == nullptr) {
+        return nullptr;
+    }
+    char* p = static_cast<char*>(base) + align;
+    std::memcpy(p - sizeof(size_t), &size, sizeof(size_t));
+    record_alloc(size);
+    return p;
+}
+
+void tracked_free(void* ptr, size_t align) {
+    if (ptr == nullptr) {
+        return;
+    }
+    if (align < alignof(std::max_align_t)) {
+        align = alignof(std::max_align_t);
+    }
+    char* p = static_cast<char*>(ptr);
+    size_t size;
+    std::memcpy(&size, p - sizeof(size_t), sizeof(size_t));
+    record_free(size);
+    std::free(p - align);
+}
+
+void* tracked_new(size_t size, size_t align) {
+    void* p = tracked_alloc(size, align);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+} // namespace
+
+MemoryRenderScope::MemoryRenderScope(const char* call) : outer_(g_depth++ == 0) {
+    if (outer_) {
+        g_current = RenderMemoryReport{};
+        g_current.call = call;
+    }
+    allocations_ = g_allocations.load(std::memory_order_relaxed);
+    bytes_ = g_bytes.load(std::memory_order_relaxed);
+    live_ = g_live.load(std::memory_order_relaxed);
+    savedPeak_ = begin_peak();
+}
+
+MemoryRenderScope::~MemoryRenderScope() {
+    --g_depth;
+    uint64_t peak = end_peak(live_, savedPeak_);
+    if (outer_) {
+        g_current.total.allocations = g_allocations.load(std::memory_order_relaxed) - allocations_;
+        g_current.total.bytes = g_bytes.load(std::memory_order_relaxed) - bytes_;
+        g_current.total.peakLiveBytes = peak;
+        g_last = g_current;
+    }
+}
+
+void MemoryRenderScope::add_cells(uint64_t cells, uint64_t vertices) {
+    g_current.cells += cells;
+    g_current.vertices += vertices;
+}
+
+MemoryStageScope::MemoryStageScope(const char* stage) : stage_(stage) {
+    allocations_ = g_allocations.load(std::memory_order_relaxed);
+    bytes_ = g_bytes.load(std::memory_order_relaxed);
+    live_ = g_live.load(std::memory_order_relaxed);
+    savedPeak_ = begin_peak();
+}
+
+void MemoryStageScope::close() {
+    if (stage_ == nullptr) {
+        return;
+    }
+    const char* stage = stage_;
+    stage_ = nullptr;
+
+    uint64_t peak = end_peak(live_, savedPeak_);
+    if (g_depth == 0) {
+        return;
+    }
+
+    StageMemory* entry = nullptr;
+    for (int i = 0; i < g_current.stageCount; ++i) {
+        if (std::strcmp(g_current.stages[i].name, stage) == 0) {
+            entry = &g_current.stages[i];
+            break;
+        }
+    }
+    if (entry == nullptr) {
+        if (g_current.stageCount == RenderMemoryReport::maxStages) {
+            return;
+        }
+        entry = &g_current.stages[g_current.stageCount++];
+        entry->name = stage;
+    }
+
+    entry->stats.allocations += g_allocations.load(std::memory_order_relaxed) - allocations_;
+    entry->stats.bytes += g_bytes.load(std::memory_order_relaxed) - bytes_;
+    if (peak > entry->stats.peakLiveBytes) {
+        entry->stats.peakLiveBytes = peak;
+    }
+}
+
+// Global allocation functions
+
+void* operator new(size_t size) { return tracked_new(size, 0); }
+void* operator new[](size_t size) { return tracked_new(size, 0); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return tracked_alloc(size, 0); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return tracked_alloc(size, 0); }
+void* operator new(size_t size, std::align_val_t align) { return tracked_new(size, (size_t)align); }
+void* operator new[](size_t size, std::align_val_t align) { return tracked_new(size, (size_t)align); }
+void* operator new(size_t size, std::align_val_t align, const std::nothrow_t&) noexcept { return tracked_alloc(size, (size_t)align); }
+void* operator new[](size_t size, std::align_val_t align, const std::nothrow_t&) noexcept { return tracked_alloc(size, (size_t)align); }
+
+void operator delete(void* p) noexcept { tracked_free(p, 0); }
+void operator delete[](void* p) noexcept { tracked_free(p, 0); }
+void operator delete(void* p, size_t) noexcept { tracked_free(p, 0); }
+void operator delete[](void* p, size_t) noexcept { tracked_free(p, 0); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { tracked_free(p, 0); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { tracked_free(p, 0); }
+void operator delete(void* p, std::align_val_t align) noexcept { tracked_free(p, (size_t)align); }
+void operator delete[](void* p, std::align_val_t align) noexcept { tracked_free(p, (size_t)align); }
+void operator delete(void* p, size_t, std::align_val_t align) noexcept { tracked_free(p, (size_t)align); }
+void operator delete[](void* p, size_t, std::align_val_t align) noexcept { tracked_free(p, (size_t)align); }
+void operator delete(void* p, std::align_val_t align, const std::nothrow_t&) noexcept { tracked_free(p, (size_t)align); }
+void operator delete[](void* p, std::align_val_t align, const std::nothrow_t&) noexcept { tracked_free(p, (size_t)align); }
+
+#endif // ALMIGHTY_MEMORY_TRACKING
@@ -0,0 +1,553 @@
+#include "polygon_union.hpp"
+#include "spatial_index.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+
+namespace {
+
+double cross(Point o, Point a, Point b) {
+    return (a.x - o.x) * (b.y - o.y) - (a.y - o.y) * (b.x - o.x);
+}
+
+struct Edge {
+    Point a, b;
+    int poly;
+    double minX, maxX, minY, maxY;
+    std::vector<Point> splits;  // points on the edge where it must be cut
+};
+
+struct Segment {
+    Point a, b;
+    long long from, to;  // snapped endpoint keys
+};
+
+// Cut e and f where they cross, touch or overlap
+void intersect_edges(Edge& e, Edge& f, double eps) {
+    Point r{e.b.x - e.a.x, e.b.y - e.a.y};
+    Point s{f.b.x - f.a.x, f.b.y - f.a.y};
+    double lenR = std::hypot(r.x, r.y), lenS = std::hypot(s.x, s.y);
+    double d = r.x * s.y - r.y * s.x;
+
+    if (std::fabs(d) <= 1e-12 * lenR * lenS) {
+        // Parallel: only collinear overlaps matter, cut at the inner endpoints
+        if (std::fabs(cross(e.a, e.b, f.a)) > eps * lenR) {
+            return;
+        }
+        auto cut_if_inside = [eps](Edge& edge, Point p) {
+            double dx = edge.b.x - edge.a.x, dy = edge.b.y - edge.a.y;
+            double len2 = dx * dx + dy * dy;
+            double t = ((p.x - edge.a.x) * dx + (p.y - edge.a.y) * dy) / len2;
+            double margin = eps / std::sqrt(len2);
+            if (t > margin && t < 1 - margin) {
+                edge.splits.push_back(p);
+            }
+        };
+        cut_if_inside(e, f.a);
+        cut_if_inside(e, f.b);
+        cut_if_inside(f, e.a);
+        cut_if_inside(f, e.b);
+        return;
+    }
+
+    Point w{f.a.x - e.a.x, f.a.y - e.a.y};
+    double t = (w.x * s.y - w.y * s.x) / d;
+    double u = (w.x * r.y - w.y * r.x) / d;
+    double te = eps / lenR, tf = eps / lenS;
+    if (t < -te || t > 1 + te || u < -tf || u > 1 + tf) {
+        return;
+    }
+    // Reuse an existing vertex where possible, so both edges share the exact point
+    Point p;
+    if (u <= tf) {
+        p = f.a;
+    } else if (u >= 1 - tf) {
+        p = f.b;
+    } else if (t <= te) {
+        p = e.a;
+    } else if (t >= 1 - te) {
+        p = e.b;
+    } else {
+        p = {e.a.x + t * r.x, e.a.y + t * r.y};
+    }
+    e.splits.push_back(p);
+    f.splits.push_back(p);
+}
+
+// Distance from p to segment ab
+double segment_distance(Point p, Point a, Point b) {
+    double dx = b.x - a.x, dy = b.y - a.y;
+    double len2 = dx * dx + dy * dy;
+    double t = len2 > 0 ? ((p.x - a.x) * dx + (p.y - a.y) * dy) / len2 : 0;
+    t = std::max(0.0, std::min(1.0, t));
+    return std::hypot(p.x - (a.x + t * dx), p.y - (a.y + t * dy));
+}
+
+BBox points_bbox(const std::vector<Point>& points) {
+    BBox box{points[0].x, points[0].y, points[0].x, points[0].y};
+    for (const auto& p : points) {
+        box.minX = std::min(box.minX, p.x);
+        box.minY = std::min(box.minY, p.y);
+        box.maxX = std::max(box.maxX, p.x);
+        box.maxY = std::max(box.maxY, p.y);
+    }
+    return box;
+}
+
+// Drop vertices that lie on the line through their neighbours
+void remove_collinear(std::vector<Point>& ring, double eps) {
+    bool changed = true;
+    while (changed && ring.size() > 3) {
+        changed = false;
+        for (size_t i = 0; i < ring.size() && ring.size() > 3; ++i) {
+            const Point& prev = ring[(i + ring.size() - 1) % ring.size()];
+            const Point& next = ring[(i + 1) % ring.size()];
+            double len = std::hypot(next.x - prev.x, next.y - prev.y);
+            if (std::fabs(cross(prev, ring[i], next)) <= eps * std::max(len, 1.0)) {
+                ring.erase(ring.begin() + i);
+                changed = true;
+            }
+        }
+    }
+}
+
+} // namespace
+
+double polygon_area(const std::vector<Point>& polygon) {
+    double area = 0;
+    for (size_t i = 0, j = polygon.size() - 1; i < polygon.size(); j = i++) {
+        area += polygon[j].x * polygon[i].y - polygon[i].x * polygon[j].y;
+    }
+    return area / 2;
+}
+
+bool polygon_union(const std::vector<std::vector<Point>>& polygons, std::vector<std::vector<Point>>& rings) {
+    rings.clear();
+
+    // Inputs with a common orientation, so coincident edges can be compared
+    std::vector<std::vector<Point>> polys;
+    double scale = 1;
+    for (const auto& polygon : polygons) {
+        if (polygon.size() < 3) {
+            continue;
+        }
+        std::vector<Point> p = polygon;
+        double area = polygon_area(p);
+        if (area == 0) {
+            continue;
+        }
+        if (area < 0) {
+            std::reverse(p.begin(), p.end());
+        }
+        for (const auto& v : p) {
+            scale = std::max(scale, std::max(std::fabs(v.x), std::fabs(v.y)));
+        }
+        polys.push_back(std::move(p));
+    }
+    if (polys.empty()) {
+        return true;
+    }
+    const double eps = scale * 1e-9;
+    const double snap = scale * 1e-7;
+
+    std::vector<Edge> edges;
+    std::vector<BBox> boxes;
+    for (size_t k = 0; k < polys.size(); ++k) {
+        const auto& p = polys[k];
+        boxes.push_back(points_bbox(p));
+        for (size_t i = 0; i < p.size(); ++i) {
+            Edge e;
+            e.a = p[i];
+            e.b = p[(i + 1) % p.size()];
+            e.poly = (int)k;
+            e.minX = std::min(e.a.x, e.b.x);
+            e.maxX = std::max(e.a.x, e.b.x);
+            e.minY = std::min(e.a.y, e.b.y);
+            e.maxY = std::max(e.a.y, e.b.y);
+            if (e.a.x != e.b.x || e.a.y != e.b.y) {
+                edges.push_back(e);
+            }
+        }
+    }
+
+    // Sweep over x: each edge is tested against every edge whose x range is
+    // still open. The active list is not ordered in y, so many edges with a
+    // wide x range make this quadratic.
+    std::vector<size_t> byX(edges.size());
+    for (size_t i = 0; i < byX.size(); ++i) {
+        byX[i] = i;
+    }
+    std::sort(byX.begin(), byX.end(), [&](size_t a, size_t b) { return edges[a].minX < edges[b].minX; });
+    std::vector<size_t> active;
+    for (size_t idx : byX) {
+        Edge& e = edges[idx];
+        for (size_t k = 0; k < active.size();) {
+            if (edges[active[k]].maxX < e.minX - eps) {
+                active[k] = active.back();
+                active.pop_back();
+            } else {
+                Edge& f = edges[active[k]];
+                if (f.poly != e.poly && f.minY <= e.maxY + eps && e.minY <= f.maxY + eps) {
+                    intersect_edges(e, f, eps);
+                }
+                ++k;
+            }
+        }
+        active.push_back(idx);
+    }
+
+    // Snapped vertex keys: points closer than `snap` are the same vertex.
+    // Coordinates are within `scale`, so each rounded axis fits in 32 bits.
+    std::unordered_map<long long, Point> vertices;
+    auto key_of = [&](Point p) {
+        long long kx = std::llround(p.x / snap), ky = std::llround(p.y / snap);
+        long long key = (long long)(((unsigned long long)kx << 32) | (uint32_t)ky);
+        vertices.emplace(key, p);
+        return key;
+    };
+
+    // Split edges and keep the pieces on the boundary of the union
+    std::vector<Segment> kept;
+    for (auto& e : edges) {
+        double dx = e.b.x - e.a.x, dy = e.b.y - e.a.y;
+        std::sort(e.splits.begin(), e.splits.end(), [&](Point p, Point q) {
+            return (p.x - e.a.x) * dx + (p.y - e.a.y) * dy < (q.x - e.a.x) * dx + (q.y - e.a.y) * dy;
+        });
+        e.splits.insert(e.splits.begin(), e.a);
+        e.splits.push_back(e.b);
+
+        for (size_t i = 0; i + 1 < e.splits.size(); ++i) {
+            Segment seg{e.splits[i], e.splits[i + 1], key_of(e.splits[i]), key_of(e.splits[i + 1])};
+            if (seg.from == seg.to) {
+                continue;
+            }
+            Point mid{(seg.a.x + seg.b.x) / 2, (seg.a.y + seg.b.y) / 2};
+            bool keep = true;
+            for (size_t q = 0; q < polys.size() && keep; ++q) {
+                const BBox& box = boxes[q];
+                if ((int)q == e.poly || mid.x < box.minX - snap || mid.x > box.maxX + snap
+                    || mid.y < box.minY - snap || mid.y > box.maxY + snap) {
+                    continue;
+                }
+                // On another boundary: shared edges in the same direction are
+                // kept once, opposite ones are an interior seam
+                const auto& other = polys[q];
+                bool onBoundary = false;
+                for (size_t j = 0; j < other.size() && !onBoundary; ++j) {
+                    const Point& a = other[j];
+                    const Point& b = other[(j + 1) % other.size()];
+                    if (segment_distance(mid, a, b) <= snap) {
+                        onBoundary = true;
+                        bool sameDirection = (b.x - a.x) * dx + (b.y - a.y) * dy > 0;
+                        keep = sameDirection && e.poly < (int)q;
+                    }
+                }
+                if (!onBoundary && point_in_polygon(mid, other.data(), other.size())) {
+                    keep = false;
+                }
+            }
+            if (keep) {
+                kept.push_back(seg);
+            }
+        }
+    }
+
+    // Link the pieces into rings
+    std::unordered_map<long long, std::vector<size_t>> outgoing;
+    for (size_t i = 0; i < kept.size(); ++i) {
+        outgoing[kept[i].from].push_back(i);
+    }
+    for (const auto& entry : outgoing) {
+        if (entry.second.size() > 1) {
+            return false;
+        }
+    }
+    std::vector<char> used(kept.size(), 0);
+    for (size_t start = 0; start < kept.size(); ++start) {
+        if (used[start]) {
+            continue;
+        }
+        std::vector<Point> ring;
+        size_t current = start;
+        while (!used[current]) {
+            used[current] = 1;
+            ring.push_back(vertices[kept[current].from]);
+            auto next = outgoing.find(kept[current].to);
+            if (next == outgoing.end()) {
+                rings.clear();
+                return false;
+            }
+            current = next->second[0];
+        }
+        if (current != start) {
+            rings.clear();
+            return false;
+        }
+        remove_collinear(ring, eps);
+        if (ring.size() >= 3) {
+            rings.push_back(std::move(ring));
+        }
+    }
+    return true;
+}
+
+bool polygon_contains(const std::vector<Point>& outer, const std::vector<Point>& inner) {
+    std::vector<std::vector<Point>> rings;
+    if (!polygon_union({outer, inner}, rings) || rings.size() != 1) {
+        return false;
+    }
+    double area = std::fabs(polygon_area(outer));
+    return std::fabs(polygon_area(rings[0]) - area) <= 1e-9 * std::max(area, 1.0);
+}
+
+namespace {
+
+// Merged outlines stop growing here, so chains of overlapping cells do not
+// turn into one huge polygon that every later union has to walk
+const size_t kMaxMergedVertices = 64;
+
+// Uniform grid of object boxes, for finding nearby candidates
+struct BoxGrid {
+    double cellSize;
+    std::unordered_map<long long, std::vector<int>> buckets;
+    std::vector<int> large;  // boxes spanning too many cells
+
+    explicit BoxGrid(double size) : cellSize(size) {}
+
+    long long key(long long x, long long y) const { return x * 73856093LL ^ y * 19349663LL; }
+
+    void insert(int id, const BBox& box) {
+        long long x0 = (long long)std::floor(box.minX / cellSize), x1 = (long long)std::floor(box.maxX / cellSize);
+        long long y0 = (long long)std::floor(box.minY / cellSize), y1 = (long long)std::floor(box.maxY / cellSize);
+        if ((x1 - x0 + 1) * (y1 - y0 + 1) > 4096) {
+            large.push_back(id);
+            return;
+        }
+        for (long long y = y0; y <= y1; ++y) {
+            for (long long x = x0; x <= x1; ++x) {
+                buckets[key(x, y)].push_back(id);
+            }
+        }
+    }
+
+    // Ids whose box may overlap `box`, sorted and unique
+    void query(const BBox& box, std::vector<int>& out) const {
+        out = large;
+        long long x0 = (long long)std::floor(box.minX / cellSize), x1 = (long long)std::floor(box.maxX / cellSize);
+        long long y0 = (long long)std::floor(box.minY / cellSize), y1 = (long long)std::floor(box.maxY / cellSize);
+        if ((x1 - x0 + 1) * (y1 - y0 + 1) > 4096) {
+            for (const auto& bucket : buckets) {
+                out.insert(out.end(), bucket.second.begin(), bucket.second.end());
+            }
+        } else {
+            for (long long y = y0; y <= y1; ++y) {
+                for (long long x = x0; x <= x1; ++x) {
+                    auto it = buckets.find(key(x, y));
+                    if (it != buckets.end()) {
+                        out.insert(out.end(), it->second.begin(), it->second.end());
+                    }
+                }
+            }
+        }
+        std::sort(out.begin(), out.end());
+        out.erase(std::unique(out.begin(), out.end()), out.end());
+    }
+};
+
+bool boxes_overlap(const BBox& a, const BBox& b) {
+    return a.minX <= b.maxX && b.minX <= a.maxX && a.minY <= b.maxY && b.minY <= a.maxY;
+}
+
+bool box_contains(const BBox& outer, const BBox& inner) {
+    return outer.minX <= inner.minX && outer.minY <= inner.minY && outer.maxX >= inner.maxX && outer.maxY >= inner.maxY;
+}
+
+// Overlap with a positive area, from the area of the union. Conservative:
+// when the union cannot be formed the objects are taken to overlap.
+bool objects_overlap(const Object& a, const Object& b) {
+    if (polygons_overlap(a.points.data(), a.points.size(), b.points.data(), b.points.size())) {
+        return true;
+    }
+    std::vector<std::vector<Point>> rings;
+    if (!polygon_union({a.points, b.points}, rings)) {
+        return true;
+    }
+    double areaA = std::fabs(polygon_area(a.points)), areaB = std::fabs(polygon_area(b.points));
+    double areaUnion = 0;
+    for (const auto& ring : rings) {
+        areaUnion += polygon_area(ring);
+    }
+    return areaUnion < (areaA + areaB) * (1 - 1e-9);
+}
+
+// SVG 1.1 color keywords, sorted for binary search
+const char* const namedColors[] = {
+    "aliceblue", "antiquewhite", "aqua", "aquamarine", "azure", "beige", "bisque", "black",
+    "blanchedalmond", "blue", "blueviolet", "brown", "burlywood", "cadetblue", "chartreuse",
+    "chocolate", "coral", "cornflowerblue", "cornsilk", "crimson", "cyan", "darkblue",
+    "darkcyan", "darkgoldenrod", "darkgray", "darkgreen", "darkgrey", "darkkhaki",
+    "darkmagenta", "darkolivegreen", "darkorange", "darkorchid", "darkred", "darksalmon",
+    "darkseagreen", "darkslateblue", "darkslategray", "darkslategrey", "darkturquoise",
+    "darkviolet", "deeppink", "deepskyblue", "dimgray", "dimgrey", "dodgerblue", "firebrick",
+    "floralwhite", "forestgreen", "fuchsia", "gainsboro", "ghostwhite", "gold", "goldenrod",
+    "gray", "green", "greenyellow", "grey", "honeydew", "hotpink", "indianred", "indigo",
+    "ivory", "khaki", "lavender", "lavenderblush", "lawngreen", "lemonchiffon", "lightblue",
+    "lightcoral", "lightcyan", "lightgoldenrodyellow", "lightgray", "lightgreen", "lightgrey",
+    "lightpink", "lightsalmon", "lightseagreen", "lightskyblue", "lightslategray",
+    "lightslategrey", "lightsteelblue", "lightyellow", "lime", "limegreen", "linen", "magenta",
+    "maroon", "mediumaquamarine", "mediumblue", "mediumorchid", "mediumpurple",
+    "mediumseagreen", "mediumslateblue", "mediumspringgreen", "mediumturquoise",
+    "mediumvioletred", "midnightblue", "mintcream", "mistyrose", "moccasin", "navajowhite",
+    "navy", "oldlace", "olive", "olivedrab", "orange", "orangered", "orchid", "palegoldenrod",
+    "palegreen", "paleturquoise", "palevioletred", "papayawhip", "peachpuff", "peru", "pink",
+    "plum", "powderblue", "purple", "red", "rosybrown", "royalblue", "saddlebrown", "salmon",
+    "sandybrown", "seagreen", "seashell", "sienna", "silver", "skyblue", "slateblue",
+    "slategray", "slategrey", "snow", "springgreen", "steelblue", "tan", "teal", "thistle",
+    "tomato", "turquoise", "violet", "wheat", "white", "whitesmoke", "yellow", "yellowgreen"
+};
+
+} // namespace
+
+bool is_opaque_color(const std::string& color) {
+    if (color.empty()) {
+        return false;
+    }
+    std::string lower;
+    for (char c : color) {
+        lower.push_back((char)std::tolower((unsigned char)c));
+    }
+
+    if (lower[0] == '#') {
+        if (lower.size() != 4 && lower.size() != 7) {
+            return false;  // #rgba, #rrggbbaa or malformed
+        }
+        return std::all_of(lower.begin() + 1, lower.end(), [](char c) { return std::isxdigit((unsigned char)c) != 0; });
+    }
+    if (lower.compare(0, 4, "rgb(") == 0 || lower.compare(0, 4, "hsl(") == 0) {
+        // Three components; a fourth (comma or " / a") is an alpha value
+        return lower.back() == ')' && std::count(lower.begin(), lower.end(), ',') <= 2
+            && lower.find('/') == std::string::npos && lower.find('"') == std::string::npos;
+    }
+    // Color keywords only: none, transparent, currentColor, inherit and
+    // unknown words are not known to be opaque
+    return std::binary_search(std::begin(namedColors), std::end(namedColors), lower.c_str(),
+        [](const char* a, const char* b) { return std::strcmp(a, b) < 0; });
+}
+
+void reduce_objects(std::vector<Object>& objects) {
+    size_t n = objects.size();
+    if (n < 2) {
+        return;
+    }
+
+    // Only polygons with an area take part; anything else is kept as is.
+    // Only opaque objects can hide others or be merged.
+    std::vector<char> alive(n, 1), polygon(n, 0), opaque(n, 0);
+    std::vector<BBox> boxes(n);
+    double extent = 0;
+    int count = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (objects[i].points.size() >= 3) {
+            polygon[i] = 1;
+            opaque[i] = is_opaque_color(objects[i].color);
+            boxes[i] = points_bbox(objects[i].points);
+            extent += (boxes[i].maxX - boxes[i].minX) + (boxes[i].maxY - boxes[i].minY);
+            ++count;
+        }
+    }
+    if (count < 2) {
+        return;
+    }
+    BoxGrid grid(std::max(extent / count, 1e-6));
+    for (size_t i = 0; i < n; ++i) {
+        if (polygon[i]) {
+            grid.insert((int)i, boxes[i]);
+        }
+    }
+    std::vector<int> candidates;
+
+    // Hidden: covered by a single later opaque object
+    for (size_t i = 0; i < n; ++i) {
+        if (!polygon[i]) {
+            continue;
+        }
+        grid.query(boxes[i], candidates);
+        for (int j : candidates) {
+            if ((size_t)j > i && alive[j] && opaque[j] && box_contains(boxes[j], boxes[i])
+                && polygon_contains(objects[j].points, objects[i].points)) {
+                alive[i] = 0;
+                break;
+            }
+        }
+    }
+
+    // Merge each object into an earlier one of the same color, nearest first
+    std::vector<std::vector<Point>> rings;
+    std::vector<int> between;
+    for (size_t j = 0; j < n; ++j) {
+        if (!polygon[j] || !alive[j] || !opaque[j]) {
+            continue;
+        }
+        grid.query(boxes[j], candidates);
+        for (auto it = candidates.rbegin(); it != candidates.rend() && alive[j]; ++it) {
+            size_t i = *it;
+            if (i >= j || !alive[i] || objects[i].color != objects[j].color || !boxes_overlap(boxes[i], boxes[j])) {
+                continue;
+            }
+            if (objects[i].points.size() + objects[j].points.size() > kMaxMergedVertices) {
+                continue;
+            }
+            if (!polygon_union({objects[i].points, objects[j].points}, rings) || rings.size() != 1
+                || rings[0].size() > objects[i].points.size() + objects[j].points.size()) {
+                continue;
+            }
+
+            // The union is painted at i or at j: objects painted in between
+            // must not overlap the part that moves
+            BBox both{std::min(boxes[i].minX, boxes[j].minX), std::min(boxes[i].minY, boxes[j].minY),
+                      std::max(boxes[i].maxX, boxes[j].maxX), std::max(boxes[i].maxY, boxes[j].maxY)};
+            grid.query(both, between);
+            bool paintAtI = true, paintAtJ = true;
+            for (int k : between) {
+                if ((size_t)k <= i || (size_t)k >= j || !alive[k] || objects[k].color == objects[i].color) {
+                    continue;
+                }
+                if (paintAtI && boxes_overlap(boxes[k], boxes[j]) && objects_overlap(objects[k], objects[j])) {
+                    paintAtI = false;
+                }
+                if (paintAtJ && boxes_overlap(boxes[k], boxes[i]) && objects_overlap(objects[k], objects[i])) {
+                    paintAtJ = false;
+                }
+                if (!paintAtI && !paintAtJ) {
+                    break;
+                }
+            }
+
+            if (paintAtI) {
+                objects[i].points = std::move(rings[0]);
+                boxes[i] = points_bbox(objects[i].points);
+                grid.insert((int)i, boxes[i]);
+                alive[j] = 0;
+            } else if (paintAtJ) {
+                objects[j].points = std::move(rings[0]);
+                boxes[j] = points_bbox(objects[j].points);
+                grid.insert((int)j, boxes[j]);
+                alive[i] = 0;
+            }
+        }
+    }
+
+    size_t out = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (alive[i]) {
+            if (out != i) {
+                objects[out] = std::move(objects[i]);
+            }
+            ++out;
+        }
+    }
+    objects.resize(out);
+}
@@ -0,0 +1,602 @@
+#include "preview_server.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+
+#ifdef __linux__
+#include <arpa/inet.h>
+#include <cerrno>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+const std::string* RenderCache::get(const std::string& key) {
+    auto it = lookup.find(key);
+    if (it == lookup.end()) {
+        return nullptr;
+    }
+    entries.splice(entries.begin(), entries, it->second);
+    return &it->second->second;
+}
+
+void RenderCache::put(const std::string& key, std::string document) {
+    if (document.size() > maxBytes) {
+        return;
+    }
+    auto it = lookup.find(key);
+    if (it != lookup.end()) {
+        bytes -= it->second->second.size();
+        entries.erase(it->second);
+        lookup.erase(it);
+    }
+    bytes += document.size();
+    entries.emplace_front(key, std::move(document));
+    lookup[key] = entries.begin();
+
+    while (bytes > maxBytes) {
+        bytes -= entries.back().second.size();
+        lookup.erase(entries.back().first);
+        entries.pop_back();
+    }
+}
+
+// State of one client socket
+struct PreviewConnection {
+    int fd = -1;
+    uint32_t events = 0;  // currently registered with epoll
+    std::string input;
+    std::string output;
+    size_t outputPos = 0;
+    bool responding = false;
+    bool closeAfterResponse = false;
+    bool peerClosed = false;  // the client shut down its side after sending
+    bool chunked = false;     // HTTP/1.1 request: streamed bodies use chunked encoding
+
+    // Streaming render, active while scene is set; holds the scene as it
+    // was when the response started
+    std::shared_ptr<const PreviewScene> scene;
+    RenderOptions options;
+    std::vector<Cell> cells;  // full layout, computed once for all bands
+    int nextRow = 0;
+    bool html = false;
+    std::string cacheKey;
+    std::string document;  // SVG sent so far, cached once complete
+    bool keepDocument = false;
+};
+
+PreviewServer::PreviewServer(const PreviewServerConfig& config) : config(config), cache(config.cacheBytes) {}
+
+void PreviewServer::add_scene(const std::string& name, const PreviewScene& scene) {
+    auto snapshot = std::make_shared<const PreviewScene>(scene);
+    std::lock_guard<std::mutex> lock(scenesMutex);
+    scenes[name] = SceneEntry{snapshot, ++sceneVersion};
+}
+
+std::shared_ptr<const PreviewScene> PreviewServer::find_scene(const std::string& name) const {
+    std::lock_guard<std::mutex> lock(scenesMutex);
+    auto it = scenes.find(name);
+    return it == scenes.end() ? nullptr : it->second.scene;
+}
+
+namespace {
+
+const size_t kMaxRequestBytes = 16384;
+
+// How the end of a response body is marked
+enum class Framing {
+    Length,      // Content-Length
+    Chunked,     // chunked transfer encoding (HTTP/1.1 only)
+    UntilClose   // closing the connection, for streamed HTTP/1.0 responses
+};
+
+std::string response_head(const char* status, const char* contentType, Framing framing, size_t length, bool close) {
+    std::string head = std::string("HTTP/1.1 ") + status + "\r\nContent-Type: " + contentType + "\r\n";
+    if (framing == Framing::Chunked) {
+        head += "Transfer-Encoding: chunked\r\n";
+    } else if (framing == Framing::Length) {
+        head += "Content-Length: " + std::to_string(length) + "\r\n";
+    }
+    head += "Cache-Control: no-store\r\n";
+    if (close) {
+        head += "Connection: close\r\n";
+    }
+    return head;
+}
+
+void append_chunk(std::string& out, const std::string& data) {
+    // A zero-size chunk would end the response
+    if (data.empty()) {
+        return;
+    }
+    char size[20];
+    int n = std::snprintf(size, sizeof(size), "%zx\r\n", data.size());
+    out.append(size, n);
+    out += data;
+    out += "\r\n";
+}
+
+// Streamed body data, chunk-framed unless the connection close ends the body
+void append_body(std::string& out, const std::string& data, bool chunked) {
+    if (chunked) {
+        append_chunk(out, data);
+    } else {
+        out += data;
+    }
+}
+
+std::string lowercase(std::string s) {
+    std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+    return s;
+}
+
+// Value of name= in the query string
+bool query_param(const std::string& query, const std::string& name, std::string& value) {
+    std::istringstream params(query);
+    std::string param;
+    while (std::getline(params, param, '&')) {
+        if (param.compare(0, name.size() + 1, name + "=") == 0) {
+            value = param.substr(name.size() + 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+#ifdef __linux__
+
+PreviewServer::~PreviewServer() {
+    for (auto& entry : connections) {
+        ::close(entry.first);
+    }
+    for (int fd : {listenFd, epollFd, wakeFd}) {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+}
+
+bool PreviewServer::start() {
+    listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listenFd < 0) {
+        std::cerr << "Error: Unable to create socket" << std::endl;
+        return false;
+    }
+    int one = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)config.port);
+    if (inet_pton(AF_INET, config.host.c_str(), &addr.sin_addr) != 1) {
+        std::cerr << "Error: Invalid address " << config.host << std::endl;
+        return false;
+    }
+    if (bind(listenFd, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(listenFd, SOMAXCONN) < 0) {
+        std::cerr << "Error: Unable to listen on " << config.host << ":" << config.port << std::endl;
+        return false;
+    }
+    socklen_t len = sizeof(addr);
+    getsockname(listenFd, (sockaddr*)&addr, &len);
+    boundPort = ntohs(addr.sin_port);
+
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epollFd < 0 || wakeFd < 0) {
+        std::cerr << "Error: Unable to create event loop" << std::endl;
+        return false;
+    }
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = listenFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &ev);
+    ev.data.fd = wakeFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &ev);
+    stopped = false;
+    return true;
+}
+
+void PreviewServer::run() {
+    while (poll(-1)) {
+    }
+}
+
+// Only write(), so it is safe from a signal handler
+void PreviewServer::stop() {
+    uint64_t one = 1;
+    if (wakeFd >= 0) {
+        ssize_t n = write(wakeFd, &one, sizeof(one));
+        (void)n;
+    }
+}
+
+bool PreviewServer::poll(int timeoutMs) {
+    if (stopped || epollFd < 0) {
+        return false;
+    }
+    epoll_event events[64];
+    int n = epoll_wait(epollFd, events, 64, timeoutMs);
+    if (n < 0 && errno != EINTR) {
+        std::cerr << "Error: epoll_wait failed" << std::endl;
+        return false;
+    }
+
+    for (int k = 0; k < n; ++k) {
+        int fd = events[k].data.fd;
+        if (fd == wakeFd) {
+            stopped = true;
+            continue;
+        }
+        if (fd == listenFd) {
+            accept_clients();
+            continue;
+        }
+        auto it = connections.find(fd);
+        if (it == connections.end()) {
+            continue;
+        }
+        PreviewConnection& conn = *it->second;
+        uint32_t flags = events[k].events;
+        bool alive = !(flags & (EPOLLERR | EPOLLHUP));
+        if (alive && (flags & EPOLLIN)) {
+            alive = read_input(conn);
+        }
+        if (alive) {
+            alive = pump(conn, (flags & EPOLLOUT) != 0);
+        }
+        if (!alive) {
+            close_connection(fd);
+        }
+    }
+    return !stopped;
+}
+
+void PreviewServer::accept_clients() {
+    for (;;) {
+        int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            return;
+        }
+        if ((int)connections.size() >= config.maxConnections) {
+            ::close(fd);
+            continue;
+        }
+        // Small first chunks must not wait for Nagle's algorithm
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        auto conn = std::make_unique<PreviewConnection>();
+        conn->fd = fd;
+        conn->events = EPOLLIN;
+        epoll_event ev{};
+        ev.events = conn->events;
+        ev.data.fd = fd;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev);
+        connections[fd] = std::move(conn);
+    }
+}
+
+void PreviewServer::close_connection(int fd) {
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    ::close(fd);
+    connections.erase(fd);
+}
+
+// Returns false once the client has gone away
+bool PreviewServer::read_input(PreviewConnection& conn) {
+    char buffer[4096];
+    for (;;) {
+        ssize_t n = recv(conn.fd, buffer, sizeof(buffer), 0);
+        if (n > 0) {
+            conn.input.append(buffer, n);
+            // Pipelined requests are read but not answered before the current one
+            if (conn.input.size() > 4 * kMaxRequestBytes) {
+                return false;
+            }
+        } else if (n == 0) {
+            // Requests already received are still answered
+            conn.peerClosed = true;
+            conn.closeAfterResponse = true;
+            return true;
+        } else {
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        }
+    }
+}
+
+bool PreviewServer::write_output(PreviewConnection& conn) {
+    while (conn.outputPos < conn.output.size()) {
+        ssize_t n = send(conn.fd, conn.output.data() + conn.outputPos, conn.output.size() - conn.outputPos, MSG_NOSIGNAL);
+        if (n < 0) {
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        }
+        conn.outputPos += n;
+    }
+    conn.output.clear();
+    conn.outputPos = 0;
+    return true;
+}
+
+// Move a connection forward as far as it can go without blocking: answer
+// the next request, send pending output, and render one more band if the
+// socket was writable. Returns false when the connection should be closed.
+bool PreviewServer::pump(PreviewConnection& conn, bool writable) {
+    for (;;) {
+        if (!conn.responding && !next_request(conn)) {
+            break;
+        }
+        if (!write_output(conn)) {
+            return false;
+        }
+        if (!conn.output.empty()) {
+            break;
+        }
+        if (conn.scene) {
+            if (!writable) {
+                break;
+            }
+            render_next_band(conn);
+            writable = false;
+            continue;
+        }
+        conn.responding = false;
+        if (conn.closeAfterResponse) {
+            return false;
+        }
+    }
+    if (conn.peerClosed && !conn.responding) {
+        return false;
+    }
+    update_events(conn);
+    return true;
+}
+
+void PreviewServer::update_events(PreviewConnection& conn) {
+    // Once the client has shut down, EPOLLIN would report end-of-file forever
+    uint32_t events = conn.peerClosed ? 0u : (uint32_t)EPOLLIN;
+    if (!conn.output.empty() || conn.scene) {
+        events |= EPOLLOUT;
+    }
+    if (events != conn.events) {
+        conn.events = events;
+        epoll_event ev{};
+        ev.events = events;
+        ev.data.fd = conn.fd;
+        epoll_ctl(epollFd, EPOLL_CTL_MOD, conn.fd, &ev);
+    }
+}
+
+#else
+
+PreviewServer::~PreviewServer() {}
+
+bool PreviewServer::start() {
+    std::cerr << "Error: The preview server needs epoll (Linux)" << std::endl;
+    return false;
+}
+
+void PreviewServer::run() {}
+void PreviewServer::stop() {}
+bool PreviewServer::poll(int) { return false; }
+
+#endif
+
+// Parse one complete request from conn.input and queue its response.
+// Returns false if the request has not fully arrived yet.
+bool PreviewServer::next_request(PreviewConnection& conn) {
+    size_t end = conn.input.find("\r\n\r\n");
+    if (end == std::string::npos) {
+        if (conn.input.size() > kMaxRequestBytes) {
+            conn.closeAfterResponse = true;
+            conn.responding = true;
+            std::string body = "Request header too large\n";
+            conn.output += response_head("431 Request Header Fields Too Large", "text/plain", Framing::Length, body.size(), true) + "\r\n" + body;
+            return true;
+        }
+        return false;
+    }
+    std::istringstream head(conn.input.substr(0, end));
+    conn.input.erase(0, end + 4);
+    conn.responding = true;
+
+    std::string line, method, target, version;
+    std::getline(head, line);
+    std::istringstream requestLine(line);
+    requestLine >> method >> target >> version;
+    conn.closeAfterResponse = conn.peerClosed || version != "HTTP/1.1";
+    conn.chunked = version == "HTTP/1.1";
+
+    bool hasBody = false;
+    while (std::getline(head, line)) {
+        line = lowercase(line);
+        if (line.compare(0, 11, "connection:") == 0) {
+            if (line.find("close") != std::string::npos) {
+                conn.closeAfterResponse = true;
+            } else if (line.find("keep-alive") != std::string::npos && version == "HTTP/1.0" && !conn.peerClosed) {
+                conn.closeAfterResponse = false;
+            }
+        } else if (line.compare(0, 18, "transfer-encoding:") == 0
+                   || (line.compare(0, 15, "content-length:") == 0 && std::atoll(line.c_str() + 15) != 0)) {
+            hasBody = true;
+        }
+    }
+
+    if (method.empty() || target.empty() || version.compare(0, 5, "HTTP/") != 0) {
+        method = "";
+    }
+    if (hasBody) {
+        // Request bodies are not read, so the stream cannot be resynchronized
+        conn.closeAfterResponse = true;
+    }
+    handle_request(conn, method, target);
+    return true;
+}
+
+void PreviewServer::handle_request(PreviewConnection& conn, const std::string& method, const std::string& target) {
+    auto reply = [&](const char* status, const char* contentType, const std::string& body) {
+        conn.output += response_head(status, contentType, Framing::Length, body.size(), conn.closeAfterResponse) + "\r\n" + body;
+    };
+    if (method.empty()) {
+        conn.closeAfterResponse = true;
+        reply("400 Bad Request", "text/plain", "Bad request\n");
+        return;
+    }
+    if (method != "GET") {
+        reply("405 Method Not Allowed", "text/plain", "Only GET is supported\n");
+        return;
+    }
+
+    size_t q = target.find('?');
+    std::string path = target.substr(0, q);
+    std::string query = q == std::string::npos ? "" : target.substr(q + 1);
+
+    if (path == "/") {
+        std::ostringstream html;
+        write_html_header(html, "Preview");
+        html << "<ul>\n";
+        {
+            std::lock_guard<std::mutex> lock(scenesMutex);
+            for (const auto& entry : scenes) {
+                html << "<li><a href=\"/scene/" << entry.first << "\">" << entry.first
+                     << "</a> (<a href=\"/scene/" << entry.first << ".svg\">svg</a>)</li>\n";
+            }
+        }
+        html << "</ul>";
+        write_html_footer(html);
+        reply("200 OK", "text/html; charset=utf-8", html.str());
+        return;
+    }
+
+    const std::string prefix = "/scene/";
+    std::string name = path.compare(0, prefix.size(), prefix) == 0 ? path.substr(prefix.size()) : "";
+    bool html = true;
+    if (name.size() > 4 && name.compare(name.size() - 4, 4, ".svg") == 0) {
+        name.resize(name.size() - 4);
+        html = false;
+    }
+    SceneEntry entry;
+    {
+        std::lock_guard<std::mutex> lock(scenesMutex);
+        auto it = scenes.find(name);
+        if (it != scenes.end()) {
+            entry = it->second;
+        }
+    }
+    if (!entry.scene) {
+        reply("404 Not Found", "text/plain", "Not found\n");
+        return;
+    }
+    const PreviewScene& scene = *entry.scene;
+
+    uint64_t seed = scene.options.seed;
+    std::string value;
+    if (query_param(query, "seed", value)) {
+        char* endPtr = nullptr;
+        seed = std::strtoull(value.c_str(), &endPtr, 10);
+        if (value.empty() || *endPtr != '\0') {
+            reply("400 Bad Request", "text/plain", "Invalid seed\n");
+            return;
+        }
+    }
+    // Every band must use the same seeds, and a seed must name one render:
+    // an unset layout seed follows the render seed
+    RenderOptions options = scene.options;
+    options.seed = resolve_seed(seed);
+    options.layout.seed = options.layout.seed ? options.layout.seed : options.seed;
+    options.index = nullptr;
+    std::string cacheKey = name + "@" + std::to_string(entry.version) + "?seed=" + std::to_string(options.seed);
+
+    const char* contentType = html ? "text/html; charset=utf-8" : "image/svg+xml";
+    std::string seedHeader = "X-Render-Seed: " + std::to_string(options.seed) + "\r\n";
+
+    std::ostringstream prefixOut, suffixOut;
+    if (html) {
+        write_html_header(prefixOut, "Preview - " + name);
+        write_html_footer(suffixOut);
+    }
+
+    if (const std::string* document = cache.get(cacheKey)) {
+        std::string body = prefixOut.str() + *document + suffixOut.str();
+        conn.output += response_head("200 OK", contentType, Framing::Length, body.size(), conn.closeAfterResponse)
+                     + seedHeader + "X-Cache: hit\r\n\r\n" + body;
+        return;
+    }
+
+    // The document header goes out right away; rows follow band by band.
+    // HTTP/1.0 has no chunked encoding: the body ends when the connection closes.
+    if (!conn.chunked) {
+        conn.closeAfterResponse = true;
+    }
+    std::ostringstream svgHeader;
+    write_svg_header(svgHeader, scene.canvas.width, scene.canvas.height);
+    conn.output += response_head("200 OK", contentType, conn.chunked ? Framing::Chunked : Framing::UntilClose, 0,
+                                 conn.closeAfterResponse)
+                 + seedHeader + "X-Cache: miss\r\n\r\n";
+    append_body(conn.output, prefixOut.str() + svgHeader.str(), conn.chunked);
+
+    conn.scene = entry.scene;
+    conn.options = options;
+    conn.nextRow = 0;
+    conn.html = html;
+    conn.cacheKey = cacheKey;
+    conn.document = svgHeader.str();
+    conn.keepDocument = true;
+}
+
+void PreviewServer::render_next_band(PreviewConnection& conn) {
+    const PreviewScene& scene = *conn.scene;
+    int rows = std::max(scene.canvas.rows, 0);
+
+    if (conn.nextRow < rows) {
+        if (conn.nextRow == 0) {
+            // Laid out once per response: a Poisson layout cannot be built per band
+            conn.cells = layout_cells(scene.canvas, conn.options.layout);
+        }
+        RenderOptions band = conn.options;
+        band.cells = &conn.cells;
+        band.rowBegin = conn.nextRow;
+        band.rowEnd = std::min(rows, conn.nextRow + std::max(1, config.rowsPerChunk));
+        conn.nextRow = band.rowEnd;
+
+        std::ostringstream out;
+        scene.renderer(out, band);
+        std::string cells = out.str();
+        append_body(conn.output, cells, conn.chunked);
+        if (conn.keepDocument) {
+            conn.document += cells;
+            // Too large to cache: stop keeping a copy
+            if (conn.document.size() > cache.maxBytes) {
+                conn.keepDocument = false;
+                std::string().swap(conn.document);
+            }
+        }
+        if (conn.nextRow < rows) {
+            return;
+        }
+    }
+
+    std::ostringstream footer;
+    write_svg_footer(footer);
+    if (conn.keepDocument) {
+        cache.put(conn.cacheKey, conn.document + footer.str());
+    }
+    if (conn.html) {
+        write_html_footer(footer);
+    }
+    append_body(conn.output, footer.str(), conn.chunked);
+    if (conn.chunked) {
+        conn.output += "0\r\n\r\n";
+    }
+
+    conn.scene.reset();
+    std::string().swap(conn.document);
+    std::vector<Cell>().swap(conn.cells);
+}
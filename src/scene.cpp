@@ -0,0 +1,190 @@
+#include "scene.hpp"
+#include "svg_utils.hpp"
+#include <cmath>
+#include <sstream>
+
+Matrix matrix_translate(double tx, double ty) {
+    Matrix m;
+    m.e = tx;
+    m.f = ty;
+    return m;
+}
+
+Matrix matrix_rotate(double angle, Point center) {
+    double rad = angle * M_PI / 180.0;
+    double cs = cos(rad);
+    double sn = sin(rad);
+
+    // Rotation around center: T(center) * R * T(-center)
+    Matrix m;
+    m.a = cs;
+    m.b = sn;
+    m.c = -sn;
+    m.d = cs;
+    m.e = center.x - cs * center.x + sn * center.y;
+    m.f = center.y - sn * center.x - cs * center.y;
+    return m;
+}
+
+Matrix matrix_scale(double k, Point center) {
+    Matrix m;
+    m.a = k;
+    m.d = k;
+    m.e = center.x - k * center.x;
+    m.f = center.y - k * center.y;
+    return m;
+}
+
+// Same semantics as apply_transform()
+Matrix matrix_from_transform(const Transform& transform, Point center) {
+    if (transform.type == "rotate") {
+        return matrix_rotate(transform.value, center);
+    } else if (transform.type == "scale") {
+        return matrix_scale(transform.value, center);
+    } else if (transform.type == "translate") {
+        return matrix_translate(transform.value, transform.value);
+    }
+    return Matrix{};
+}
+
+Matrix matrix_multiply(const Matrix& m, const Matrix& n) {
+    Matrix r;
+    r.a = m.a * n.a + m.c * n.b;
+    r.b = m.b * n.a + m.d * n.b;
+    r.c = m.a * n.c + m.c * n.d;
+    r.d = m.b * n.c + m.d * n.d;
+    r.e = m.a * n.e + m.c * n.f + m.e;
+    r.f = m.b * n.e + m.d * n.f + m.f;
+    return r;
+}
+
+Point matrix_apply(const Matrix& m, const Point& p) {
+    return {m.a * p.x + m.c * p.y + m.e, m.b * p.x + m.d * p.y + m.f};
+}
+
+bool matrix_is_identity(const Matrix& m) {
+    return m.a == 1 && m.b == 0 && m.c == 0 && m.d == 1 && m.e == 0 && m.f == 0;
+}
+
+std::string matrix_to_svg(const Matrix& m) {
+    // Pure translations are written as translate() to keep the output readable
+    if (m.a == 1 && m.b == 0 && m.c == 0 && m.d == 1) {
+        return "translate(" + std::to_string(m.e) + "," + std::to_string(m.f) + ")";
+    }
+    return "matrix(" + std::to_string(m.a) + "," + std::to_string(m.b) + ","
+        + std::to_string(m.c) + "," + std::to_string(m.d) + ","
+        + std::to_string(m.e) + "," + std::to_string(m.f) + ")";
+}
+
+SceneNode::SceneNode(const std::string& name) : name_(name) {}
+
+SceneNode* SceneNode::add_child(const std::string& name) {
+    children_.push_back(std::make_unique<SceneNode>(name));
+    SceneNode* child = children_.back().get();
+    child->parent_ = this;
+    return child;
+}
+
+void SceneNode::add_object(const Object& obj) {
+    objects_.push_back(obj);
+}
+
+void SceneNode::set_local(const Matrix& m) {
+    local_ = m;
+    invalidate();
+}
+
+void SceneNode::apply(const Matrix& m) {
+    set_local(matrix_multiply(m, local_));
+}
+
+void SceneNode::apply(const Transform& transform, Point center) {
+    apply(matrix_from_transform(transform, center));
+}
+
+// A dirty node always has dirty descendants (world() cleans parents first),
+// so the walk can stop at the first node that is already dirty.
+void SceneNode::invalidate() {
+    if (dirty_) {
+        return;
+    }
+    dirty_ = true;
+    for (auto& child : children_) {
+        child->invalidate();
+    }
+}
+
+const Matrix& SceneNode::world() const {
+    if (dirty_) {
+        world_ = parent_ ? matrix_multiply(parent_->world(), local_) : local_;
+        dirty_ = false;
+    }
+    return world_;
+}
+
+std::unique_ptr<SceneNode> scene_from_canvas(const Canvas& canvas, const Layout& layout) {
+    auto root = std::make_unique<SceneNode>("canvas");
+
+    for (const auto& cell : layout_cells(canvas, layout)) {
+        SceneNode* node = root->add_child("cell_" + std::to_string(cell.row) + "_" + std::to_string(cell.col));
+        node->set_local(matrix_translate(cell.center.x, cell.center.y));
+        for (const auto& obj : canvas.baseObject) {
+            node->add_object(obj);
+        }
+    }
+    return root;
+}
+
+void scene_flatten(const SceneNode& root, std::vector<Object>& out) {
+    const Matrix& world = root.world();
+    bool identity = matrix_is_identity(world);
+
+    for (const auto& obj : root.objects()) {
+        out.push_back(obj);
+        if (!identity) {
+            for (auto& point : out.back().points) {
+                point = matrix_apply(world, point);
+            }
+        }
+    }
+    for (const auto& child : root.children()) {
+        scene_flatten(*child, out);
+    }
+}
+
+std::string scene_node_to_svg(const SceneNode& node) {
+    std::ostringstream svg;
+    bool group = !matrix_is_identity(node.local());
+
+    if (group) {
+        svg << "<g transform=\"" << matrix_to_svg(node.local()) << "\">\n";
+    }
+    for (const auto& obj : node.objects()) {
+        svg << object_to_svg(obj);
+    }
+    for (const auto& child : node.children()) {
+        svg << scene_node_to_svg(*child);
+    }
+    if (group) {
+        svg << "</g>\n";
+    }
+    return svg.str();
+}
+
+std::string scene_to_svg(const SceneNode& root, int width, int height, bool flatten) {
+    std::ostringstream svg;
+    write_svg_header(svg, width, height);
+
+    if (flatten) {
+        std::vector<Object> objects;
+        scene_flatten(root, objects);
+        for (const auto& obj : objects) {
+            svg << object_to_svg(obj);
+        }
+    } else {
+        svg << scene_node_to_svg(root);
+    }
+
+    write_svg_footer(svg);
+    return svg.str();
+}
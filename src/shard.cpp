@@ -0,0 +1,160 @@
+#include "shard.hpp"
+#include "gzip_stream.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+#ifndef _WIN32
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+std::vector<Shard> plan_shards(const Canvas& canvas, int shardCount, const std::string& directory) {
+    std::vector<Shard> shards;
+    int rows = std::max(canvas.rows, 0);
+    if (shardCount < 1) {
+        shardCount = 1;
+    }
+    if (shardCount > rows && rows > 0) {
+        shardCount = rows;
+    }
+
+    for (int k = 0; k < shardCount; ++k) {
+        Shard shard;
+        shard.index = k;
+        shard.rowBegin = (int)((long long)rows * k / shardCount);
+        shard.rowEnd = (int)((long long)rows * (k + 1) / shardCount);
+        shard.path = directory + "/shard_" + std::to_string(k) + ".svgpart";
+        shards.push_back(shard);
+    }
+    return shards;
+}
+
+RenderOptions resolve_shard_options(const RenderOptions& options) {
+    RenderOptions resolved = options;
+    resolved.seed = resolve_seed(options.seed);
+    resolved.layout.seed = resolve_seed(options.layout.seed);
+    return resolved;
+}
+
+bool render_shard(const Shard& shard, const ShardRenderer& renderer, const RenderOptions& options) {
+    if (options.seed == 0 || options.layout.seed == 0) {
+        std::cerr << "Error: Shard options must be resolved before rendering" << std::endl;
+        return false;
+    }
+    RenderOptions band = options;
+    band.rowBegin = shard.rowBegin;
+    band.rowEnd = shard.rowEnd;
+
+    // Written under a temporary name so a merge never sees a partial shard
+    std::string tmpPath = shard.path + ".tmp";
+    std::ofstream file(tmpPath, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Error: Unable to open shard file " << tmpPath << std::endl;
+        return false;
+    }
+    renderer(file, band);
+    file.close();
+    if (!file) {
+        std::cerr << "Error: Unable to write shard file " << tmpPath << std::endl;
+        return false;
+    }
+    return std::rename(tmpPath.c_str(), shard.path.c_str()) == 0;
+}
+
+bool merge_svg_shards(const Canvas& canvas, const std::vector<Shard>& shards, std::ostream& out) {
+    write_svg_header(out, canvas.width, canvas.height);
+    for (const auto& shard : shards) {
+        std::ifstream file(shard.path, std::ios::binary);
+        if (!file.is_open()) {
+            std::cerr << "Error: Missing shard file " << shard.path << std::endl;
+            return false;
+        }
+        // An empty band is a valid shard, but operator<< flags it as a failure
+        if (file.peek() != std::ifstream::traits_type::eof()) {
+            out << file.rdbuf();
+        }
+    }
+    write_svg_footer(out);
+    return (bool)out;
+}
+
+bool merge_svg_shards(const Canvas& canvas, const std::vector<Shard>& shards, const std::string& outputPath) {
+    std::ofstream file(outputPath, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Error: Unable to open " << outputPath << std::endl;
+        return false;
+    }
+    if (is_gzip_path(outputPath)) {
+        GzipOStream gz(file);
+        return merge_svg_shards(canvas, shards, gz) && gz.finish();
+    }
+    return merge_svg_shards(canvas, shards, file);
+}
+
+bool render_sharded(
+    const Canvas& canvas,
+    const ShardRenderer& renderer,
+    const RenderOptions& options,
+    int shardCount,
+    int workers,
+    const std::string& directory,
+    const std::string& outputPath
+) {
+    std::vector<Shard> shards = plan_shards(canvas, shardCount, directory);
+    RenderOptions resolved = resolve_shard_options(options);
+    bool ok = true;
+
+#ifdef _WIN32
+    // No fork(): render the bands one after another in this process
+    (void)workers;
+    for (const auto& shard : shards) {
+        ok = render_shard(shard, renderer, resolved) && ok;
+    }
+#else
+    if (workers < 1) {
+        workers = 1;
+    }
+
+    // Buffered output would otherwise be duplicated into every worker
+    std::cout.flush();
+    std::cerr.flush();
+    std::fflush(nullptr);
+
+    int running = 0;
+    auto wait_one = [&]() {
+        int status = 0;
+        if (waitpid(-1, &status, 0) > 0) {
+            --running;
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                ok = false;
+            }
+        }
+    };
+
+    for (const auto& shard : shards) {
+        if (running == workers) {
+            wait_one();
+        }
+        pid_t pid = fork();
+        if (pid == 0) {
+            _exit(render_shard(shard, renderer, resolved) ? 0 : 1);
+        } else if (pid < 0) {
+            // Could not start a worker: render this band here instead
+            ok = render_shard(shard, renderer, resolved) && ok;
+        } else {
+            ++running;
+        }
+    }
+    while (running > 0) {
+        wait_one();
+    }
+#endif
+
+    if (!ok) {
+        std::cerr << "Error: A shard failed to render" << std::endl;
+        return false;
+    }
+    return merge_svg_shards(canvas, shards, outputPath);
+}
@@ -0,0 +1,399 @@
+#include "spatial_index.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+
+namespace {
+
+BBox bbox_union(const BBox& a, const BBox& b) {
+    return {std::min(a.minX, b.minX), std::min(a.minY, b.minY),
+            std::max(a.maxX, b.maxX), std::max(a.maxY, b.maxY)};
+}
+
+bool bbox_overlaps(const BBox& a, const BBox& b) {
+    return a.minX <= b.maxX && b.minX <= a.maxX && a.minY <= b.maxY && b.minY <= a.maxY;
+}
+
+bool bbox_contains(const BBox& box, Point p) {
+    return p.x >= box.minX && p.x <= box.maxX && p.y >= box.minY && p.y <= box.maxY;
+}
+
+BBox polygon_bbox(const Point* polygon, size_t count) {
+    BBox box{polygon[0].x, polygon[0].y, polygon[0].x, polygon[0].y};
+    for (size_t i = 1; i < count; ++i) {
+        box.minX = std::min(box.minX, polygon[i].x);
+        box.minY = std::min(box.minY, polygon[i].y);
+        box.maxX = std::max(box.maxX, polygon[i].x);
+        box.maxY = std::max(box.maxY, polygon[i].y);
+    }
+    return box;
+}
+
+// Spread the low 16 bits of v to the even bit positions
+uint32_t expand_bits(uint32_t v) {
+    v &= 0xFFFF;
+    v = (v | (v << 8)) & 0x00FF00FF;
+    v = (v | (v << 4)) & 0x0F0F0F0F;
+    v = (v | (v << 2)) & 0x33333333;
+    v = (v | (v << 1)) & 0x55555555;
+    return v;
+}
+
+// Runs fn(begin, end) over [0, n) split into one chunk per thread
+template <typename Fn>
+void parallel_for(size_t n, int threads, const Fn& fn) {
+    size_t chunks = std::max<size_t>(1, std::min<size_t>(threads, n / 4096));
+    if (chunks == 1) {
+        fn(0, n);
+        return;
+    }
+    std::vector<std::thread> workers;
+    for (size_t c = 0; c < chunks; ++c) {
+        workers.emplace_back(fn, n * c / chunks, n * (c + 1) / chunks);
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+double cross(Point o, Point a, Point b) {
+    return (a.x - o.x) * (b.y - o.y) - (a.y - o.y) * (b.x - o.x);
+}
+
+bool segments_cross(Point a, Point b, Point c, Point d) {
+    double d1 = cross(a, b, c), d2 = cross(a, b, d);
+    double d3 = cross(c, d, a), d4 = cross(c, d, b);
+    return ((d1 > 0 && d2 < 0) || (d1 < 0 && d2 > 0)) && ((d3 > 0 && d4 < 0) || (d3 < 0 && d4 > 0));
+}
+
+// Collinear segments sharing a piece of positive length
+bool segments_overlap_collinear(Point a, Point b, Point c, Point d) {
+    if (cross(a, b, c) != 0 || cross(a, b, d) != 0 || (a.x == b.x && a.y == b.y)) {
+        return false;
+    }
+    // Project onto the longer axis of ab
+    bool useX = std::fabs(b.x - a.x) >= std::fabs(b.y - a.y);
+    double a0 = useX ? a.x : a.y, a1 = useX ? b.x : b.y;
+    double c0 = useX ? c.x : c.y, c1 = useX ? d.x : d.y;
+    return std::min(std::max(a0, a1), std::max(c0, c1)) > std::max(std::min(a0, a1), std::min(c0, c1));
+}
+
+// p on the closed segment ab
+bool on_segment(Point p, Point a, Point b) {
+    return cross(a, b, p) == 0 && p.x >= std::min(a.x, b.x) && p.x <= std::max(a.x, b.x)
+        && p.y >= std::min(a.y, b.y) && p.y <= std::max(a.y, b.y);
+}
+
+bool on_boundary(Point p, const Point* polygon, size_t count) {
+    for (size_t j = 0; j < count; ++j) {
+        if (on_segment(p, polygon[j], polygon[(j + 1) % count])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// With no proper crossings, a's boundary only meets b's at b's vertices or at
+// a's own vertices. Cut each edge of a at those points: every piece then lies
+// wholly inside b, outside it, or on its boundary, so testing one point per
+// piece finds any part of a's boundary inside b (concave shapes included).
+bool boundary_inside(const Point* a, size_t countA, const Point* b, size_t countB) {
+    std::vector<double> cuts;
+    for (size_t i = 0; i < countA; ++i) {
+        Point a0 = a[i], a1 = a[(i + 1) % countA];
+        double dx = a1.x - a0.x, dy = a1.y - a0.y;
+        double length2 = dx * dx + dy * dy;
+        if (length2 == 0) {
+            continue;
+        }
+        cuts.assign({0.0, 1.0});
+        for (size_t j = 0; j < countB; ++j) {
+            if (on_segment(b[j], a0, a1)) {
+                cuts.push_back(((b[j].x - a0.x) * dx + (b[j].y - a0.y) * dy) / length2);
+            }
+        }
+        std::sort(cuts.begin(), cuts.end());
+        for (size_t k = 0; k + 1 < cuts.size(); ++k) {
+            if (cuts[k + 1] <= cuts[k]) {
+                continue;
+            }
+            double t = (cuts[k] + cuts[k + 1]) / 2;
+            Point p{a0.x + t * dx, a0.y + t * dy};
+            if (!on_boundary(p, b, countB) && point_in_polygon(p, b, countB)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+// Crossing number (even-odd rule)
+bool point_in_polygon(Point p, const Point* polygon, size_t count) {
+    bool inside = false;
+    for (size_t i = 0, j = count - 1; i < count; j = i++) {
+        const Point& a = polygon[i];
+        const Point& b = polygon[j];
+        if ((a.y > p.y) != (b.y > p.y) && p.x < (b.x - a.x) * (p.y - a.y) / (b.y - a.y) + a.x) {
+            inside = !inside;
+        }
+    }
+    return inside;
+}
+
+// Edges crossing properly or sharing a collinear piece, or part of one
+// boundary inside the other polygon
+bool polygons_overlap(const Point* a, size_t countA, const Point* b, size_t countB) {
+    if (countA < 3 || countB < 3) {
+        return false;
+    }
+    for (size_t i = 0; i < countA; ++i) {
+        Point a0 = a[i], a1 = a[(i + 1) % countA];
+        for (size_t j = 0; j < countB; ++j) {
+            Point b0 = b[j], b1 = b[(j + 1) % countB];
+            if (segments_cross(a0, a1, b0, b1) || segments_overlap_collinear(a0, a1, b0, b1)) {
+                return true;
+            }
+        }
+    }
+    return boundary_inside(a, countA, b, countB) || boundary_inside(b, countB, a, countA);
+}
+
+void SceneIndex::clear() {
+    *this = SceneIndex{};
+}
+
+void SceneIndex::add(const Object& obj, const Cell& cell, int objectIndex) {
+    if (obj.points.empty()) {
+        return;
+    }
+    hits.push_back({cell.id, cell.row, cell.col, objectIndex});
+    boxes.push_back(polygon_bbox(obj.points.data(), obj.points.size()));
+    points.insert(points.end(), obj.points.begin(), obj.points.end());
+    pointOffsets.push_back((uint32_t)points.size());
+}
+
+void SceneIndex::add_cell(const Cell& cell, const std::vector<Object>& objects) {
+    for (size_t k = 0; k < objects.size(); ++k) {
+        add(objects[k], cell, (int)k);
+    }
+}
+
+void SceneIndex::build(int threads) {
+    size_t n = hits.size();
+    if (threads <= 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    order.resize(n);
+    left.assign(n > 1 ? n - 1 : 0, 0);
+    right.assign(n > 1 ? n - 1 : 0, 0);
+    nodeBoxes.resize(n > 1 ? n - 1 : 0);
+    if (n == 0) {
+        return;
+    }
+
+    // Morton codes of the box centers
+    BBox bounds = boxes[0];
+    for (const auto& box : boxes) {
+        bounds = bbox_union(bounds, box);
+    }
+    double sx = bounds.maxX > bounds.minX ? 65535.0 / (bounds.maxX - bounds.minX) : 0;
+    double sy = bounds.maxY > bounds.minY ? 65535.0 / (bounds.maxY - bounds.minY) : 0;
+
+    std::vector<uint32_t> codes(n);
+    parallel_for(n, threads, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            double cx = (boxes[i].minX + boxes[i].maxX) / 2;
+            double cy = (boxes[i].minY + boxes[i].maxY) / 2;
+            uint32_t x = (uint32_t)((cx - bounds.minX) * sx);
+            uint32_t y = (uint32_t)((cy - bounds.minY) * sy);
+            codes[i] = (expand_bits(x) << 1) | expand_bits(y);
+        }
+    });
+
+    // LSD radix sort of (code, index), 8 bits per pass
+    std::vector<uint32_t> tmpOrder(n), tmpCodes(n);
+    for (size_t i = 0; i < n; ++i) {
+        order[i] = (uint32_t)i;
+    }
+    for (int shift = 0; shift < 32; shift += 8) {
+        size_t count[257] = {0};
+        for (size_t i = 0; i < n; ++i) {
+            ++count[((codes[i] >> shift) & 0xFF) + 1];
+        }
+        for (int b = 0; b < 256; ++b) {
+            count[b + 1] += count[b];
+        }
+        for (size_t i = 0; i < n; ++i) {
+            size_t dst = count[(codes[i] >> shift) & 0xFF]++;
+            tmpCodes[dst] = codes[i];
+            tmpOrder[dst] = order[i];
+        }
+        codes.swap(tmpCodes);
+        order.swap(tmpOrder);
+    }
+    if (n == 1) {
+        return;
+    }
+
+    // Length of the common prefix of keys i and j, ties broken by index
+    auto delta = [&](long long i, long long j) -> int {
+        if (j < 0 || j >= (long long)n) {
+            return -1;
+        }
+        uint32_t x = codes[i] ^ codes[j];
+        if (x != 0) {
+            return __builtin_clz(x);
+        }
+        return 32 + __builtin_clz((uint32_t)(i ^ j));
+    };
+
+    // Each internal node is found independently of the others
+    std::vector<int> parentOfNode(n - 1, -1), parentOfLeaf(n, -1);
+    parallel_for(n - 1, threads, [&](size_t begin, size_t end) {
+        for (long long i = begin; i < (long long)end; ++i) {
+            int d = delta(i, i + 1) - delta(i, i - 1) > 0 ? 1 : -1;
+            int deltaMin = delta(i, i - d);
+
+            long long lmax = 2;
+            while (delta(i, i + lmax * d) > deltaMin) {
+                lmax *= 2;
+            }
+            long long l = 0;
+            for (long long t = lmax / 2; t >= 1; t /= 2) {
+                if (delta(i, i + (l + t) * d) > deltaMin) {
+                    l += t;
+                }
+            }
+            long long j = i + l * d;
+            int deltaNode = delta(i, j);
+
+            long long s = 0;
+            long long t = l;
+            do {
+                t = (t + 1) / 2;
+                if (delta(i, i + (s + t) * d) > deltaNode) {
+                    s += t;
+                }
+            } while (t > 1);
+            long long split = i + s * d + std::min(d, 0);
+
+            if (std::min(i, j) == split) {
+                left[i] = ~(int)split;
+                parentOfLeaf[split] = (int)i;
+            } else {
+                left[i] = (int)split;
+                parentOfNode[split] = (int)i;
+            }
+            if (std::max(i, j) == split + 1) {
+                right[i] = ~(int)(split + 1);
+                parentOfLeaf[split + 1] = (int)i;
+            } else {
+                right[i] = (int)(split + 1);
+                parentOfNode[split + 1] = (int)i;
+            }
+        }
+    });
+
+    // Bottom-up boxes: the second child to arrive at a node computes it
+    std::vector<std::atomic<int>> arrivals(n - 1);
+    for (auto& arrival : arrivals) {
+        arrival.store(0, std::memory_order_relaxed);
+    }
+    auto child_box = [&](int ref) -> const BBox& {
+        return ref < 0 ? boxes[order[~ref]] : nodeBoxes[ref];
+    };
+    parallel_for(n, threads, [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; ++k) {
+            int node = parentOfLeaf[k];
+            while (node >= 0 && arrivals[node].fetch_add(1, std::memory_order_acq_rel) == 1) {
+                nodeBoxes[node] = bbox_union(child_box(left[node]), child_box(right[node]));
+                node = parentOfNode[node];
+            }
+        }
+    });
+}
+
+template <typename Overlaps, typename Visit>
+void SceneIndex::traverse(const Overlaps& overlaps, const Visit& visit) const {
+    if (order.empty()) {
+        return;
+    }
+    // Each level extends the common prefix of the (code, index) key, so the
+    // depth and the stack of pending siblings stay below 64 + 1
+    int stack[96];
+    int top = 0;
+    stack[top++] = order.size() == 1 ? ~0 : 0;
+
+    while (top > 0) {
+        int ref = stack[--top];
+        if (ref < 0) {
+            uint32_t id = order[~ref];
+            if (overlaps(boxes[id])) {
+                visit(id);
+            }
+        } else if (overlaps(nodeBoxes[ref])) {
+            stack[top++] = left[ref];
+            stack[top++] = right[ref];
+        }
+    }
+}
+
+void SceneIndex::pick(Point p, std::vector<Hit>& out) const {
+    std::vector<uint32_t> ids;
+    traverse([&](const BBox& box) { return bbox_contains(box, p); },
+             [&](uint32_t id) {
+                 if (point_in_polygon(p, &points[pointOffsets[id]], pointOffsets[id + 1] - pointOffsets[id])) {
+                     ids.push_back(id);
+                 }
+             });
+    std::sort(ids.begin(), ids.end(), std::greater<uint32_t>());
+    for (uint32_t id : ids) {
+        out.push_back(hits[id]);
+    }
+}
+
+void SceneIndex::query_polygon_ids(const Point* polygon, size_t count, const BBox& box, std::vector<uint32_t>& out) const {
+    traverse([&](const BBox& other) { return bbox_overlaps(box, other); },
+             [&](uint32_t id) {
+                 if (polygons_overlap(&points[pointOffsets[id]], pointOffsets[id + 1] - pointOffsets[id], polygon, count)) {
+                     out.push_back(id);
+                 }
+             });
+    std::sort(out.begin(), out.end());
+}
+
+void SceneIndex::query_rect(const BBox& rect, std::vector<Hit>& out) const {
+    Point corners[4] = {{rect.minX, rect.minY}, {rect.maxX, rect.minY}, {rect.maxX, rect.maxY}, {rect.minX, rect.maxY}};
+    std::vector<uint32_t> ids;
+    query_polygon_ids(corners, 4, rect, ids);
+    for (uint32_t id : ids) {
+        out.push_back(hits[id]);
+    }
+}
+
+void SceneIndex::query_polygon(const std::vector<Point>& polygon, std::vector<Hit>& out) const {
+    if (polygon.size() < 3) {
+        return;
+    }
+    std::vector<uint32_t> ids;
+    query_polygon_ids(polygon.data(), polygon.size(), polygon_bbox(polygon.data(), polygon.size()), ids);
+    for (uint32_t id : ids) {
+        out.push_back(hits[id]);
+    }
+}
+
+void SceneIndex::overlapping_cells(std::vector<std::pair<Hit, Hit>>& out) const {
+    std::vector<uint32_t> ids;
+    for (uint32_t i = 0; i < hits.size(); ++i) {
+        ids.clear();
+        query_polygon_ids(&points[pointOffsets[i]], pointOffsets[i + 1] - pointOffsets[i], boxes[i], ids);
+        for (uint32_t j : ids) {
+            if (j > i && hits[j].cell != hits[i].cell) {
+                out.push_back({hits[i], hits[j]});
+            }
+        }
+    }
+}
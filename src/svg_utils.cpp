@@ -1,13 +1,29 @@
 #include "svg_utils.hpp"
+#include "expression.hpp"
+#include "memory_stats.hpp"
+#include "polygon_union.hpp"
+#include "spatial_index.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <iterator>
+#include <unordered_map>
 #include <sstream>
 #include <cmath>
-#include <random>
 
 // Helper function to convert a point to an SVG string
 std::string point_to_svg(const Point& p) {
     return std::to_string(p.x) + "," + std::to_string(p.y);
 }
 
+// Total number of vertices in a composed object
+static uint64_t count_vertices(const std::vector<Object>& objects) {
+    uint64_t count = 0;
+    for (const auto& obj : objects) {
+        count += obj.points.size();
+    }
+    return count;
+}
+
 // Function to generate SVG for a single object
 std::string object_to_svg(const Object& obj) {
     std::ostringstream svg;
@@ -19,177 +35,721 @@ std::string object_to_svg(const Object& obj) {
     return svg.str();
 }
 
-// Function to generate SVG for a canvas without transformations
-std::string canvas_composed_to_svg(const Canvas& canvas) {
+namespace {
+
+// Small stack buffer in front of the stream, so path output does not allocate
+struct PathBuffer {
+    std::ostream& out;
+    char data[512];
+    size_t size = 0;
+
+    explicit PathBuffer(std::ostream& stream) : out(stream) {}
+    ~PathBuffer() { flush(); }
+
+    void flush() {
+        out.write(data, size);
+        size = 0;
+    }
+    void reserve(size_t n) {
+        if (size + n > sizeof(data)) {
+            flush();
+        }
+    }
+    void put(char c) {
+        reserve(1);
+        data[size++] = c;
+    }
+    void put(const char* s, size_t n) {
+        if (n > sizeof(data)) {
+            flush();
+            out.write(s, n);
+            return;
+        }
+        reserve(n);
+        for (size_t i = 0; i < n; ++i) {
+            data[size++] = s[i];
+        }
+    }
+};
+
+// Quantum as an integer number of 10^-decimals units (0.01 -> 1 unit, 2 decimals)
+struct Quantum {
+    long long unit;
+    int decimals;
+};
+
+Quantum make_quantum(double quantum) {
+    if (!(quantum > 0)) {
+        quantum = 0.01;
+    }
+    double scale = 1;
+    for (int d = 0; d <= 9; ++d, scale *= 10) {
+        double units = quantum * scale;
+        if (std::fabs(units - std::round(units)) < 1e-9 * units) {
+            return {std::llround(units), d};
+        }
+    }
+    return {std::max(1LL, std::llround(quantum * 1e9)), 9};
+}
+
+// Shortest decimal text for value * 10^-decimals: no trailing zeros, no leading "0."
+size_t format_fixed(long long value, int decimals, char* dst) {
+    char digits[24];
+    int count = 0;
+    unsigned long long v = value < 0 ? -(unsigned long long)value : (unsigned long long)value;
+    do {
+        digits[count++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v != 0);
+
+    // Trailing zeros of the fractional part
+    int skip = 0;
+    while (skip < decimals && skip < count && digits[skip] == '0') {
+        ++skip;
+    }
+    if (skip == count) {
+        dst[0] = '0';
+        return 1;
+    }
+
+    size_t n = 0;
+    if (value < 0) {
+        dst[n++] = '-';
+    }
+    for (int i = std::max(count, decimals) - 1; i >= skip; --i) {
+        if (i == decimals - 1) {
+            dst[n++] = '.';
+        }
+        dst[n++] = i < count ? digits[i] : '0';
+    }
+    return n;
+}
+
+// Collinear check on quantized points: b lies on segment a->c, same direction
+bool redundant_vertex(const long long* a, const long long* b, const long long* c) {
+    long long ux = b[0] - a[0], uy = b[1] - a[1];
+    long long vx = c[0] - b[0], vy = c[1] - b[1];
+    if (ux == 0 && uy == 0) {
+        return true;
+    }
+    return ux * vy - uy * vx == 0 && ux * vx + uy * vy > 0;
+}
+
+} // namespace
+
+void write_object_svg_path(std::ostream& out, const Object& obj, double quantum) {
+    Quantum q = make_quantum(quantum);
+    double toUnits = std::pow(10.0, q.decimals) / q.unit;
+
+    // Quantize, dropping duplicate and collinear vertices as we go
+    std::vector<long long> pts;
+    pts.reserve(obj.points.size() * 2);
+    for (const auto& point : obj.points) {
+        long long p[2] = {std::llround(point.x * toUnits), std::llround(point.y * toUnits)};
+        while (pts.size() >= 4 && redundant_vertex(&pts[pts.size() - 4], &pts[pts.size() - 2], p)) {
+            pts.resize(pts.size() - 2);
+        }
+        if (pts.size() >= 2 && pts[pts.size() - 2] == p[0] && pts[pts.size() - 1] == p[1]) {
+            continue;
+        }
+        pts.push_back(p[0]);
+        pts.push_back(p[1]);
+    }
+
+    // The polygon is closed: also simplify around the first/last vertex
+    size_t first = 0;
+    size_t count = pts.size() / 2;
+    bool changed = true;
+    while (changed && count >= 3) {
+        changed = false;
+        const long long* head = &pts[first * 2];
+        const long long* last = &pts[(first + count - 1) * 2];
+        if (redundant_vertex(&pts[(first + count - 2) * 2], last, head)) {
+            --count;
+            changed = true;
+        } else if (redundant_vertex(last, head, &pts[(first + 1) * 2])) {
+            ++first;
+            --count;
+            changed = true;
+        }
+    }
+
+    PathBuffer buf(out);
+    buf.put("<path d=\"", 9);
+    char num[32];
+    char previousCommand = 0;
+    bool previousHasDot = false;
+
+    // Separator only when the next number would otherwise merge with the previous one
+    auto put_number = [&](long long units, bool afterCommand) {
+        size_t n = format_fixed(units * q.unit, q.decimals, num);
+        if (!afterCommand && num[0] != '-' && !(previousHasDot && num[0] == '.')) {
+            buf.put(' ');
+        }
+        buf.put(num, n);
+        previousHasDot = std::find(num, num + n, '.') != num + n;
+    };
+
+    for (size_t i = 0; i < count; ++i) {
+        const long long* p = &pts[(first + i) * 2];
+        if (i == 0) {
+            buf.put('M');
+            put_number(p[0], true);
+            put_number(p[1], false);
+            previousCommand = 'M';
+            continue;
+        }
+
+        const long long* prev = &pts[(first + i - 1) * 2];
+        long long dx = p[0] - prev[0];
+        long long dy = p[1] - prev[1];
+        char command = dy == 0 ? 'h' : (dx == 0 ? 'v' : 'l');
+        bool afterCommand = command != previousCommand;
+        if (afterCommand) {
+            buf.put(command);
+            previousCommand = command;
+        }
+        if (command == 'h') {
+            put_number(dx, afterCommand);
+        } else if (command == 'v') {
+            put_number(dy, afterCommand);
+        } else {
+            put_number(dx, afterCommand);
+            put_number(dy, false);
+        }
+    }
+
+    buf.put("z\" fill=\"", 9);
+    buf.put(obj.color.data(), obj.color.size());
+    buf.put("\"/>\n", 4);
+}
+
+std::string object_to_svg_path(const Object& obj, double quantum) {
     std::ostringstream svg;
-    svg << "<svg width=\"" << canvas.width << "\" height=\"" << canvas.height 
+    write_object_svg_path(svg, obj, quantum);
+    return svg.str();
+}
+
+void write_object_svg(std::ostream& out, const Object& obj, const RenderOptions& options) {
+    if (options.geometry == "path") {
+        write_object_svg_path(out, obj, options.quantum);
+    } else {
+        out << object_to_svg(obj);
+    }
+}
+
+void write_svg_header(std::ostream& out, int width, int height) {
+    out << "<svg width=\"" << width << "\" height=\"" << height
         << "\" xmlns=\"http://www.w3.org/2000/svg\">\n";
+}
 
-    double spacingX = canvas.width / (canvas.cols + 1);
-    double spacingY = canvas.height / (canvas.rows + 1);
-
-    for (int i = 0; i < canvas.rows; ++i) {
-        for (int j = 0; j < canvas.cols; ++j) {
-            // Create a copy of the complex object
-            std::vector<Object> objects = canvas.baseObject;
-            
-            // Translate the complex object to its position
-            double tx = (j + 1) * spacingX;
-            double ty = (i + 1) * spacingY;
-            translate_composedObject(objects, tx, ty);
-
-            // Add all objects to SVG
-            for (const auto& obj : objects) {
-                svg << object_to_svg(obj);
+void write_svg_footer(std::ostream& out) {
+    out << "</svg>";
+}
+
+// Layout stage shared by the renderers: cells of the selected rows
+static std::vector<Cell> render_cells(const Canvas& canvas, const RenderOptions& options) {
+    MemoryStageScope stage("layout");
+    if (options.cells) {
+        return cells_in_rows(*options.cells, options.rowBegin, options.rowEnd);
+    }
+    return layout_cells(canvas, options.layout, options.rowBegin, options.rowEnd);
+}
+
+// Serialize stage shared by the renderers. With options.reduce == "canvas"
+// the objects are held back and reduced together after the last cell.
+static void write_cell_objects(
+    std::ostream& out,
+    std::vector<Object>& objects,
+    const RenderOptions& options,
+    std::vector<Object>& heldBack
+) {
+    if (options.reduce == "canvas") {
+        heldBack.insert(heldBack.end(), std::make_move_iterator(objects.begin()), std::make_move_iterator(objects.end()));
+        return;
+    }
+    if (options.reduce == "cell") {
+        MemoryStageScope stage("reduce");
+        reduce_objects(objects);
+    }
+    MemoryStageScope stage("serialize");
+    for (const auto& obj : objects) {
+        write_object_svg(out, obj, options);
+    }
+}
+
+static void write_held_back_objects(std::ostream& out, std::vector<Object>& heldBack, const RenderOptions& options) {
+    if (heldBack.empty()) {
+        return;
+    }
+    MemoryStageScope reduceStage("reduce");
+    reduce_objects(heldBack);
+    reduceStage.close();
+
+    MemoryStageScope serializeStage("serialize");
+    for (const auto& obj : heldBack) {
+        write_object_svg(out, obj, options);
+    }
+}
+
+// Transformed base objects shared by every cell with the same transform
+// sequence, kept relative to the cell center (options.memoize)
+struct MemoizedCell {
+    std::vector<Object> objects;
+    std::string svg;  // the objects serialized, for memoize == "svg"
+};
+
+// Merge runs of rotations and scales and drop identities, so equivalent
+// sequences share one entry. Returns the key of the canonical sequence.
+static std::string canonical_transforms(const std::vector<Transform>& sequence, std::vector<Transform>& canonical) {
+    canonical.clear();
+    for (const auto& transform : sequence) {
+        if (!canonical.empty() && canonical.back().type == transform.type) {
+            if (transform.type == "scale") {
+                canonical.back().value *= transform.value;
+            } else {
+                canonical.back().value += transform.value;
             }
+        } else {
+            canonical.push_back({transform.type, transform.value});
+        }
+        double identity = canonical.back().type == "scale" ? 1 : 0;
+        if (canonical.back().value == identity) {
+            canonical.pop_back();
         }
     }
 
-    svg << "</svg>";
-    return svg.str();
+    std::string key;
+    char value[32];
+    for (const auto& transform : canonical) {
+        std::snprintf(value, sizeof(value), "(%.17g);", transform.value);
+        key += transform.type + value;
+    }
+    return key;
 }
 
-// Function to generate SVG for a canvas with transformations
-std::string canvas_transform_composed_to_svg(const Canvas& canvas, const std::vector<std::pair<std::string, double>>& transforms) {
-    std::ostringstream svg;
-    svg << "<svg width=\"" << canvas.width << "\" height=\"" << canvas.height 
-        << "\" xmlns=\"http://www.w3.org/2000/svg\">\n";
+// objectIndex >= 0 transforms only that object, as in the list renderer
+static MemoizedCell& memoized_cell(
+    std::unordered_map<std::string, MemoizedCell>& memo,
+    const Canvas& canvas,
+    const std::vector<Transform>& sequence,
+    int objectIndex,
+    const RenderOptions& options
+) {
+    std::vector<Transform> canonical;
+    std::string key = canonical_transforms(sequence, canonical);
+    auto it = memo.find(key);
+    if (it != memo.end()) {
+        return it->second;
+    }
 
-    double spacingX = canvas.width / (canvas.cols + 1);
-    double spacingY = canvas.height / (canvas.rows + 1);
-
-    for (int i = 0; i < canvas.rows; ++i) {
-        for (int j = 0; j < canvas.cols; ++j) {
-            // Create a copy of the base objects
-            std::vector<Object> objects = canvas.baseObject;
-
-            // Calculate center position for this grid cell
-            double tx = (j + 1) * spacingX;
-            double ty = (i + 1) * spacingY;
-            
-            // First translate to position
-            translate_composedObject(objects, tx, ty);
-
-            // Apply each transformation
-            for (const auto& transform : transforms) {
-                if (transform.first == "translate") {
-                    translate_composedObject(objects, transform.second, transform.second);
-                } 
-                else if (transform.first == "rotate") {
-                    // Calculate center of the object group
-                    double centerX = tx;
-                    double centerY = ty;
-                    
-                    for (auto& obj : objects) {
-                        for (auto& point : obj.points) {
-                            // Convert angle to radians
-                            double rad = transform.second * M_PI / 180.0;
-                            
-                            // Translate point to origin
-                            double dx = point.x - centerX;
-                            double dy = point.y - centerY;
-                            
-                            // Rotate point
-                            double newX = dx * cos(rad) - dy * sin(rad);
-                            double newY = dx * sin(rad) + dy * cos(rad);
-                            
-                            // Translate back
-                            point.x = centerX + newX;
-                            point.y = centerY + newY;
-                        }
-                    }
-                } 
-                else if (transform.first == "scale") {
-                    // Calculate center of the object group
-                    double centerX = tx;
-                    double centerY = ty;
-                    
-                    for (auto& obj : objects) {
-                        for (auto& point : obj.points) {
-                            // Scale point relative to center
-                            point.x = centerX + (point.x - centerX) * transform.second;
-                            point.y = centerY + (point.y - centerY) * transform.second;
-                        }
+    MemoizedCell& entry = memo[key];
+    entry.objects = canvas.baseObject;
+    Point origin{0, 0};
+    for (size_t k = 0; k < entry.objects.size(); ++k) {
+        if (objectIndex >= 0 && objectIndex < (int)entry.objects.size() && (int)k != objectIndex) {
+            continue;
+        }
+        for (const auto& transform : canonical) {
+            apply_transform(entry.objects[k], transform, origin);
+        }
+    }
+    if (options.memoize == "svg") {
+        std::ostringstream svg;
+        for (const auto& obj : entry.objects) {
+            write_object_svg(svg, obj, options);
+        }
+        entry.svg = svg.str();
+    }
+    return entry;
+}
+
+// Writes the cell from its memoized entry. Returns false when the caller
+// needs absolute geometry instead (index or reduction), after placing it
+// in `objects`.
+static bool write_memoized_cell(
+    std::ostream& out,
+    const MemoizedCell& entry,
+    Point center,
+    const RenderOptions& options,
+    std::vector<Object>& objects
+) {
+    if (options.memoize == "svg" && !options.index && options.reduce == "none") {
+        MemoryStageScope stage("serialize");
+        char offset[64];
+        int n = std::snprintf(offset, sizeof(offset), "<g transform=\"translate(%.10g,%.10g)\">\n", center.x, center.y);
+        out.write(offset, n);
+        out << entry.svg << "</g>\n";
+        return true;
+    }
+    MemoryStageScope stage("transform");
+    objects = entry.objects;
+    translate_composedObject(objects, center.x, center.y);
+    return false;
+}
+
+// Cell elements for a canvas without transformations
+void canvas_composed_write(std::ostream& out, const Canvas& canvas, const RenderOptions& options) {
+    MemoryRenderScope memory("canvas_composed_write");
+    std::vector<Cell> cells = render_cells(canvas, options);
+    std::vector<Object> heldBack;
+    std::unordered_map<std::string, MemoizedCell> memo;
+    const MemoizedCell* memoized = options.memoize == "none" ? nullptr : &memoized_cell(memo, canvas, {}, -1, options);
+
+    for (const auto& cell : cells) {
+        if (memoized) {
+            std::vector<Object> objects;
+            if (!write_memoized_cell(out, *memoized, cell.center, options, objects)) {
+                if (options.index) {
+                    options.index->add_cell(cell, objects);
+                }
+                write_cell_objects(out, objects, options, heldBack);
+            }
+            continue;
+        }
+
+        MemoryStageScope transformStage("transform");
+
+        // Create a copy of the complex object
+        std::vector<Object> objects = canvas.baseObject;
+
+        // Translate the complex object to its position
+        translate_composedObject(objects, cell.center.x, cell.center.y);
+        transformStage.close();
+
+        if (options.index) {
+            options.index->add_cell(cell, objects);
+        }
+
+        // Add all objects to SVG
+        write_cell_objects(out, objects, options, heldBack);
+    }
+    write_held_back_objects(out, heldBack, options);
+
+    memory.add_cells(cells.size(), cells.size() * count_vertices(canvas.baseObject));
+}
+
+// Cell elements for a canvas with transformations
+void canvas_transform_composed_write(
+    std::ostream& out,
+    const Canvas& canvas,
+    const std::vector<std::pair<std::string, double>>& transforms,
+    const RenderOptions& options
+) {
+    MemoryRenderScope memory("canvas_transform_composed_write");
+    std::vector<Cell> cells = render_cells(canvas, options);
+    std::vector<Object> heldBack;
+
+    // Every cell gets the same sequence: one memoized entry
+    std::unordered_map<std::string, MemoizedCell> memo;
+    const MemoizedCell* memoized = nullptr;
+    if (options.memoize != "none") {
+        std::vector<Transform> sequence;
+        for (const auto& transform : transforms) {
+            sequence.push_back({transform.first, transform.second});
+        }
+        memoized = &memoized_cell(memo, canvas, sequence, -1, options);
+    }
+
+    for (const auto& cell : cells) {
+        if (memoized) {
+            std::vector<Object> objects;
+            if (!write_memoized_cell(out, *memoized, cell.center, options, objects)) {
+                if (options.index) {
+                    options.index->add_cell(cell, objects);
+                }
+                write_cell_objects(out, objects, options, heldBack);
+            }
+            continue;
+        }
+
+        MemoryStageScope transformStage("transform");
+
+        // Create a copy of the base objects
+        std::vector<Object> objects = canvas.baseObject;
+
+        // Center position for this cell
+        double tx = cell.center.x;
+        double ty = cell.center.y;
+
+        // First translate to position
+        translate_composedObject(objects, tx, ty);
+
+        // Apply each transformation
+        for (const auto& transform : transforms) {
+            if (transform.first == "translate") {
+                translate_composedObject(objects, transform.second, transform.second);
+            }
+            else if (transform.first == "rotate") {
+                // Calculate center of the object group
+                double centerX = tx;
+                double centerY = ty;
+
+                for (auto& obj : objects) {
+                    for (auto& point : obj.points) {
+                        // Convert angle to radians
+                        double rad = transform.second * M_PI / 180.0;
+
+                        // Translate point to origin
+                        double dx = point.x - centerX;
+                        double dy = point.y - centerY;
+
+                        // Rotate point
+                        double newX = dx * cos(rad) - dy * sin(rad);
+                        double newY = dx * sin(rad) + dy * cos(rad);
+
+                        // Translate back
+                        point.x = centerX + newX;
+                        point.y = centerY + newY;
                     }
                 }
             }
+            else if (transform.first == "scale") {
+                // Calculate center of the object group
+                double centerX = tx;
+                double centerY = ty;
 
-            // Add transformed objects to SVG
-            for (const auto& obj : objects) {
-                svg << object_to_svg(obj);
+                for (auto& obj : objects) {
+                    for (auto& point : obj.points) {
+                        // Scale point relative to center
+                        point.x = centerX + (point.x - centerX) * transform.second;
+                        point.y = centerY + (point.y - centerY) * transform.second;
+                    }
+                }
             }
         }
+
+        transformStage.close();
+
+        if (options.index) {
+            options.index->add_cell(cell, objects);
+        }
+
+        // Add transformed objects to SVG
+        write_cell_objects(out, objects, options, heldBack);
     }
+    write_held_back_objects(out, heldBack, options);
 
-    svg << "</svg>";
-    return svg.str();
+    memory.add_cells(cells.size(), cells.size() * count_vertices(canvas.baseObject));
 }
 
-std::string canvas_list_transform_simpleObject_to_svg(
+// Cell elements with 0, 1 or 2 transformations picked per cell
+void canvas_list_transform_simpleObject_write(
+    std::ostream& out,
     const Canvas& canvas,
     const std::vector<Transform>& possible_transforms,
-    int objectIndex
+    int objectIndex,
+    const RenderOptions& options
 ) {
-    std::ostringstream svg;
-    svg << "<svg width=\"" << canvas.width << "\" height=\"" << canvas.height 
-        << "\" xmlns=\"http://www.w3.org/2000/svg\">\n";
+    MemoryRenderScope memory("canvas_list_transform_simpleObject_write");
+    std::vector<Cell> cells = render_cells(canvas, options);
+    std::vector<Object> heldBack;
+    uint64_t seed = resolve_seed(options.seed);
+
+    // At most three sequences (0, 1 or 2 transforms), memoized on first use
+    std::unordered_map<std::string, MemoizedCell> memo;
+    const MemoizedCell* memoizedByCount[3] = {nullptr, nullptr, nullptr};
+
+    for (const auto& cell : cells) {
+        if (options.memoize != "none") {
+            int count = possible_transforms.empty() ? 0 : (int)(cell_seed(seed, cell) % 3);
+            if (!memoizedByCount[count]) {
+                std::vector<Transform> sequence;
+                for (int t = 0; t < count; ++t) {
+                    sequence.push_back(possible_transforms[t % possible_transforms.size()]);
+                }
+                memoizedByCount[count] = &memoized_cell(memo, canvas, sequence, objectIndex, options);
+            }
+            std::vector<Object> cell_objects;
+            if (!write_memoized_cell(out, *memoizedByCount[count], cell.center, options, cell_objects)) {
+                if (options.index) {
+                    options.index->add_cell(cell, cell_objects);
+                }
+                write_cell_objects(out, cell_objects, options, heldBack);
+            }
+            continue;
+        }
+
+        MemoryStageScope transformStage("transform");
+        std::vector<Object> cell_objects = canvas.baseObject;
+        Point center = cell.center;
 
-    double spacingX = canvas.width / (canvas.cols + 1);
-    double spacingY = canvas.height / (canvas.rows + 1);
-
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<> dis(0, 2); // 0, 1, or 2 transformations
-
-    for (int i = 0; i < canvas.rows; ++i) {
-        for (int j = 0; j < canvas.cols; ++j) {
-            std::vector<Object> cell_objects = canvas.baseObject;
-            Point center{(j + 1) * spacingX, (i + 1) * spacingY};
-            
-            // Translate the whole group to position
-            translate_composedObject(cell_objects, center.x, center.y);
-
-            // Apply random transformations to specific object or all objects
-            int numTransforms = dis(gen);
-            if (objectIndex >= 0 && objectIndex < cell_objects.size()) {
-                // Apply to specific object
+        // Translate the whole group to position
+        translate_composedObject(cell_objects, center.x, center.y);
+
+        // Apply random transformations to specific object or all objects.
+        // The count is drawn from the cell's own seed so it does not depend
+        // on which other cells are rendered.
+        int numTransforms = possible_transforms.empty() ? 0 : (int)(cell_seed(seed, cell) % 3);
+        if (objectIndex >= 0 && objectIndex < (int)cell_objects.size()) {
+            // Apply to specific object
+            for (int t = 0; t < numTransforms; ++t) {
+                apply_transform(cell_objects[objectIndex],
+                              possible_transforms[t % possible_transforms.size()],
+                              center);
+            }
+        } else {
+            // Apply to all objects
+            for (auto& obj : cell_objects) {
                 for (int t = 0; t < numTransforms; ++t) {
-                    apply_transform(cell_objects[objectIndex], 
-                                  possible_transforms[t % possible_transforms.size()], 
+                    apply_transform(obj,
+                                  possible_transforms[t % possible_transforms.size()],
                                   center);
                 }
-            } else {
-                // Apply to all objects
-                for (auto& obj : cell_objects) {
-                    for (int t = 0; t < numTransforms; ++t) {
-                        apply_transform(obj, 
-                                      possible_transforms[t % possible_transforms.size()], 
-                                      center);
-                    }
-                }
             }
+        }
+
+        transformStage.close();
+
+        if (options.index) {
+            options.index->add_cell(cell, cell_objects);
+        }
+
+        // Add all objects to SVG
+        write_cell_objects(out, cell_objects, options, heldBack);
+    }
+    write_held_back_objects(out, heldBack, options);
+
+    memory.add_cells(cells.size(), cells.size() * count_vertices(canvas.baseObject));
+}
+
+// Cell elements with transform values evaluated per cell
+bool canvas_expression_transform_composed_write(
+    std::ostream& out,
+    const Canvas& canvas,
+    const std::vector<std::pair<std::string, std::string>>& transforms,
+    const RenderOptions& options,
+    std::string* error
+) {
+    MemoryRenderScope memory("canvas_expression_transform_composed_write");
+
+    // Compile every expression once
+    std::vector<Expression> expressions(transforms.size());
+    for (size_t t = 0; t < transforms.size(); ++t) {
+        std::string message;
+        if (!compile_expression(transforms[t].second, expressions[t], message)) {
+            if (error) {
+                *error = transforms[t].first + ": " + message;
+            }
+            return false;
+        }
+    }
 
-            // Add all objects to SVG
-            for (const auto& obj : cell_objects) {
-                svg << object_to_svg(obj);
+    std::vector<Cell> cells = render_cells(canvas, options);
+    std::vector<Object> heldBack;
+    uint64_t seed = resolve_seed(options.seed);
+
+    // Evaluate each expression over all cells in batches
+    std::vector<std::vector<double>> values(transforms.size());
+    {
+        MemoryStageScope stage("evaluate");
+        ExprInputs inputs = expression_inputs(canvas, cells);
+        for (size_t t = 0; t < transforms.size(); ++t) {
+            evaluate_expression(expressions[t], inputs, seed, values[t]);
+        }
+    }
+
+    for (size_t k = 0; k < cells.size(); ++k) {
+        MemoryStageScope transformStage("transform");
+        std::vector<Object> objects = canvas.baseObject;
+        Point center = cells[k].center;
+
+        // Translate to position, then apply the transforms around the cell center
+        translate_composedObject(objects, center.x, center.y);
+        for (size_t t = 0; t < transforms.size(); ++t) {
+            Transform transform{transforms[t].first, values[t][k]};
+            for (auto& obj : objects) {
+                apply_transform(obj, transform, center);
             }
         }
+        transformStage.close();
+
+        if (options.index) {
+            options.index->add_cell(cells[k], objects);
+        }
+
+        write_cell_objects(out, objects, options, heldBack);
     }
+    write_held_back_objects(out, heldBack, options);
+
+    memory.add_cells(cells.size(), cells.size() * count_vertices(canvas.baseObject));
+    return true;
+}
 
-    svg << "</svg>";
+// Function to generate SVG for a canvas without transformations
+std::string canvas_composed_to_svg(const Canvas& canvas, const RenderOptions& options) {
+    MemoryRenderScope memory("canvas_composed_to_svg");
+    std::ostringstream svg;
+    write_svg_header(svg, canvas.width, canvas.height);
+    canvas_composed_write(svg, canvas, options);
+    write_svg_footer(svg);
+
+    MemoryStageScope stage("output");
     return svg.str();
 }
 
+// Function to generate SVG for a canvas with transformations
+std::string canvas_transform_composed_to_svg(
+    const Canvas& canvas,
+    const std::vector<std::pair<std::string, double>>& transforms,
+    const RenderOptions& options
+) {
+    MemoryRenderScope memory("canvas_transform_composed_to_svg");
+    std::ostringstream svg;
+    write_svg_header(svg, canvas.width, canvas.height);
+    canvas_transform_composed_write(svg, canvas, transforms, options);
+    write_svg_footer(svg);
+
+    MemoryStageScope stage("output");
+    return svg.str();
+}
+
+std::string canvas_list_transform_simpleObject_to_svg(
+    const Canvas& canvas,
+    const std::vector<Transform>& possible_transforms,
+    int objectIndex,
+    const RenderOptions& options
+) {
+    MemoryRenderScope memory("canvas_list_transform_simpleObject_to_svg");
+    std::ostringstream svg;
+    write_svg_header(svg, canvas.width, canvas.height);
+    canvas_list_transform_simpleObject_write(svg, canvas, possible_transforms, objectIndex, options);
+    write_svg_footer(svg);
+
+    MemoryStageScope stage("output");
+    return svg.str();
+}
+
+std::string canvas_expression_transform_composed_to_svg(
+    const Canvas& canvas,
+    const std::vector<std::pair<std::string, std::string>>& transforms,
+    const RenderOptions& options,
+    std::string* error
+) {
+    MemoryRenderScope memory("canvas_expression_transform_composed_to_svg");
+    std::ostringstream svg;
+    write_svg_header(svg, canvas.width, canvas.height);
+    if (!canvas_expression_transform_composed_write(svg, canvas, transforms, options, error)) {
+        return "";
+    }
+    write_svg_footer(svg);
+
+    MemoryStageScope stage("output");
+    return svg.str();
+}
+
+void write_html_header(std::ostream& out, const std::string& title) {
+    out << "\n<!DOCTYPE html>\n<html>\n<head>\n    <title>" << title << "</title>\n</head>\n<body>\n";
+}
+
+void write_html_footer(std::ostream& out) {
+    out << "\n</body>\n</html>\n";
+}
+
 std::string create_html_wrapper(const std::string& svg, const std::string& title) {
-    return R"(
-<!DOCTYPE html>
-<html>
-<head>
-    <title>)" + title + R"(</title>
-</head>
-<body>
-)" + svg + R"(
-</body>
-</html>
-)";
+    std::ostringstream html;
+    write_html_header(html, title);
+    html << svg;
+    write_html_footer(html);
+    return html.str();
 }
\ No newline at end of file
@@ -0,0 +1,184 @@
+#include "../include/canvas.hpp"
+#include "../include/expression.hpp"
+#include "../include/layout.hpp"
+#include "../include/svg_utils.hpp"
+#include <cassert>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+
+// Build with -D_GLIBCXX_ASSERTIONS (library and test) so that stack slots
+// indexed out of range abort instead of passing silently.
+
+// Create a square centered on the origin
+Object create_square(double size, const std::string& color) {
+    Object obj;
+    obj.points = {
+        {-size / 2, -size / 2},
+        {size / 2, -size / 2},
+        {size / 2, size / 2},
+        {-size / 2, size / 2}
+    };
+    obj.color = color;
+    return obj;
+}
+
+Canvas create_canvas(int rows, int cols) {
+    Canvas canvas;
+    canvas.width = 800;
+    canvas.height = 800;
+    canvas.baseObject = {create_square(30, "black")};
+    canvas.rows = rows;
+    canvas.cols = cols;
+    return canvas;
+}
+
+std::vector<double> evaluate(const std::string& source, const Canvas& canvas, uint64_t seed = 1) {
+    Expression expr;
+    std::string error;
+    bool ok = compile_expression(source, expr, error);
+    if (!ok) {
+        std::cerr << error << std::endl;
+    }
+    assert(ok);
+
+    std::vector<double> values;
+    evaluate_expression(expr, expression_inputs(canvas, grid_layout(canvas)), seed, values);
+    return values;
+}
+
+void test_arithmetic() {
+    Canvas canvas = create_canvas(30, 40);  // spans several batches
+    std::vector<Cell> cells = grid_layout(canvas);
+    std::vector<double> values = evaluate("row * 2 + col - -1", canvas);
+    for (size_t k = 0; k < cells.size(); ++k) {
+        assert(values[k] == cells[k].row * 2 + cells[k].col + 1);
+    }
+
+    values = evaluate("2 ^ 3 ^ 2 / (1 + 1) + max(u, v) * 0 + min(3, abs(-2)) + floor(sqrt(10))", canvas);
+    assert(values[0] == 256 + 2 + 3);
+
+    values = evaluate("sin(pi / 2) + cos(0)", canvas);
+    assert(std::fabs(values[17] - 2) < 1e-12);
+}
+
+// Every instruction at full stack depth, across batch boundaries
+void test_stack_depth() {
+    Canvas canvas = create_canvas(20, 20);
+    std::vector<Cell> cells = grid_layout(canvas);
+    std::vector<double> values = evaluate("1+2", canvas);
+    assert(values[0] == 3 && values[cells.size() - 1] == 3);
+
+    values = evaluate("row - (col - (1 - (2 * max(u, min(v, noise(x, rand()))))))", canvas);
+    for (size_t k = 0; k < cells.size(); ++k) {
+        assert(std::isfinite(values[k]));
+    }
+    values = evaluate("-abs(sqrt(floor(sin(cos(row)))) ^ (col / (1 + 2)))", canvas);
+    assert(values.size() == cells.size());
+}
+
+// u, v follow the actual cell centers, not the grid indices
+void test_uv_follow_layout() {
+    Canvas canvas = create_canvas(10, 10);
+    Layout layout;
+    layout.type = "jittered";
+    layout.seed = 9;
+    std::vector<Cell> cells = layout_cells(canvas, layout);
+    ExprInputs inputs = expression_inputs(canvas, cells);
+    Expression u, v;
+    std::string error;
+    bool ok = compile_expression("u", u, error) && compile_expression("v", v, error);
+    assert(ok);
+    std::vector<double> us, vs;
+    evaluate_expression(u, inputs, 1, us);
+    evaluate_expression(v, inputs, 1, vs);
+    std::vector<Cell> grid = grid_layout(canvas);
+    bool moved = false;
+    for (size_t k = 0; k < cells.size(); ++k) {
+        assert(us[k] == cells[k].center.x / 800 && vs[k] == cells[k].center.y / 800);
+        assert(us[k] >= 0 && us[k] <= 1 && vs[k] >= 0 && vs[k] <= 1);
+        moved = moved || us[k] != grid[k].center.x / 800;
+    }
+    assert(moved);
+}
+
+// Lattice coordinates beyond the int range, and non-finite inputs
+void test_noise_large_inputs() {
+    Canvas canvas = create_canvas(4, 4);
+    std::vector<double> values = evaluate("noise(x * 1e12, y * 1e300) + noise(-x * 1e18, y - 1e30)", canvas);
+    for (double value : values) {
+        assert(value >= 0 && value < 2);
+    }
+    // Propagate like the other functions, without undefined behaviour
+    values = evaluate("noise(1 / 0, y) + noise(0 / 0, y)", canvas);
+    assert(std::isnan(values[0]));
+    assert(evaluate("noise(x * 1e12, y)", canvas) == evaluate("noise(x * 1e12, y)", canvas));
+}
+
+void test_compile_errors() {
+    Expression expr;
+    std::string error;
+    assert(!compile_expression("row +", expr, error) && !error.empty());
+    assert(!compile_expression("foo(1)", expr, error));
+    assert(!compile_expression("max(1)", expr, error));
+    assert(!compile_expression("(row", expr, error));
+    assert(!compile_expression("row col", expr, error));
+}
+
+void test_random_is_stable() {
+    Canvas canvas = create_canvas(20, 20);
+    std::vector<double> a = evaluate("rand() + noise(u * 4, v * 4)", canvas, 5);
+    std::vector<double> b = evaluate("rand() + noise(u * 4, v * 4)", canvas, 5);
+    std::vector<double> c = evaluate("rand() + noise(u * 4, v * 4)", canvas, 6);
+    assert(a == b);
+    assert(a != c);
+    for (double value : a) {
+        assert(value >= 0 && value < 2);
+    }
+
+    // Two call sites give independent values
+    std::vector<double> d = evaluate("rand() - rand()", canvas);
+    bool differs = false;
+    for (double value : d) {
+        differs = differs || value != 0;
+    }
+    assert(differs);
+}
+
+// Vera Molnár, "(Dés)Ordres": disorder grows toward the bottom-right
+void test_desordres() {
+    Canvas canvas = create_canvas(16, 16);
+    canvas.baseObject = {create_square(40, "black"), create_square(28, "black"), create_square(16, "black")};
+    for (auto& obj : canvas.baseObject) {
+        obj.color = "none\" stroke=\"black";
+    }
+
+    RenderOptions options;
+    options.seed = 3;
+    std::string svg = canvas_expression_transform_composed_to_svg(canvas, {
+        {"rotate", "(rand() - 0.5) * 60 * u * v"},
+        {"scale", "1 - 0.4 * rand() * (u + v) / 2"}
+    }, options);
+    assert(!svg.empty());
+    std::string error;
+    assert(canvas_expression_transform_composed_to_svg(canvas, {{"rotate", "rand("}}, options, &error).empty());
+    assert(error.compare(0, 8, "rotate: ") == 0 && error.find("Expected ')'") != std::string::npos);
+
+    std::ofstream file("desordres.html");
+    if (file.is_open()) {
+        file << create_html_wrapper(svg, "Vera Molnar - (Des)Ordres");
+        file.close();
+    }
+}
+
+int main() {
+    test_arithmetic();
+    test_stack_depth();
+    test_uv_follow_layout();
+    test_noise_large_inputs();
+    test_compile_errors();
+    test_random_is_stable();
+    test_desordres();
+    std::cout << "Expression tests passed" << std::endl;
+    return 0;
+}
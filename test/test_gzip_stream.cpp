@@ -0,0 +1,396 @@
+#include "../include/canvas.hpp"
+#include "../include/geometry.hpp"
+#include "../include/gzip_stream.hpp"
+#include "../include/shard.hpp"
+#include "../include/svg_utils.hpp"
+#include <cassert>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#ifdef ALMIGHTY_ZLIB
+#include <zlib.h>
+#endif
+
+// Create a square centered on the origin
+Object create_square(double size, const std::string& color) {
+    Object obj;
+    obj.points = {
+        {-size / 2, -size / 2},
+        {size / 2, -size / 2},
+        {size / 2, size / 2},
+        {-size / 2, size / 2}
+    };
+    obj.color = color;
+    return obj;
+}
+
+Canvas create_canvas(int rows, int cols) {
+    Canvas canvas;
+    canvas.width = cols * 40;
+    canvas.height = rows * 40;
+    canvas.baseObject = {create_square(30, "blue"), create_square(20, "red"), create_square(10, "blue")};
+    canvas.rows = rows;
+    canvas.cols = cols;
+    return canvas;
+}
+
+std::string read_file(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    std::ostringstream content;
+    content << file.rdbuf();
+    return content.str();
+}
+
+// Minimal inflater (RFC 1951/1952) to check the output without a dependency
+struct Inflater {
+    const std::string& in;
+    size_t pos = 0;
+    uint32_t bits = 0;
+    int count = 0;
+
+    explicit Inflater(const std::string& data) : in(data) {}
+
+    int bit() {
+        if (count == 0) {
+            assert(pos < in.size());
+            bits = (uint8_t)in[pos++];
+            count = 8;
+        }
+        int b = bits & 1;
+        bits >>= 1;
+        --count;
+        return b;
+    }
+
+    int read(int n) {
+        int value = 0;
+        for (int k = 0; k < n; ++k) {
+            value |= bit() << k;
+        }
+        return value;
+    }
+
+    // Canonical Huffman code from code lengths
+    struct Huffman {
+        std::vector<int> counts, symbols;
+    };
+
+    static Huffman build(const std::vector<int>& lengths) {
+        Huffman h;
+        h.counts.assign(16, 0);
+        for (int l : lengths) {
+            h.counts[l]++;
+        }
+        h.counts[0] = 0;
+        std::vector<int> offsets(16, 0);
+        for (int l = 1; l < 16; ++l) {
+            offsets[l] = offsets[l - 1] + h.counts[l - 1];
+        }
+        h.symbols.assign(lengths.size(), 0);
+        for (size_t s = 0; s < lengths.size(); ++s) {
+            if (lengths[s] != 0) {
+                h.symbols[offsets[lengths[s]]++] = (int)s;
+            }
+        }
+        return h;
+    }
+
+    int decode(const Huffman& h) {
+        int code = 0, first = 0, index = 0;
+        for (int l = 1; l < 16; ++l) {
+            code |= bit();
+            int n = h.counts[l];
+            if (code - n < first) {
+                return h.symbols[index + (code - first)];
+            }
+            index += n;
+            first = (first + n) << 1;
+            code <<= 1;
+        }
+        assert(false);
+        return -1;
+    }
+
+    std::string gunzip() {
+        assert(in.size() >= 18 && (uint8_t)in[0] == 0x1F && (uint8_t)in[1] == 0x8B && in[2] == 8);
+        assert(in[3] == 0);  // no optional header fields
+        pos = 10;
+
+        static const int lengthBase[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                           35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+        static const int lengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                            3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+        static const int distanceBase[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+                                             257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+                                             8193, 12289, 16385, 24577};
+        static const int distanceExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+                                              7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+        std::string out;
+        int final;
+        do {
+            final = bit();
+            int type = read(2);
+            if (type == 0) {
+                count = 0;
+                int length = (uint8_t)in[pos] | ((uint8_t)in[pos + 1] << 8);
+                int complement = (uint8_t)in[pos + 2] | ((uint8_t)in[pos + 3] << 8);
+                assert((length ^ 0xFFFF) == complement);
+                out.append(in, pos + 4, length);
+                pos += 4 + length;
+                continue;
+            }
+            assert(type == 1 || type == 2);
+
+            std::vector<int> literalLengths(288), distanceLengths(30, 5);
+            if (type == 1) {
+                for (int s = 0; s < 288; ++s) {
+                    literalLengths[s] = s < 144 ? 8 : s < 256 ? 9 : s < 280 ? 7 : 8;
+                }
+            } else {
+                int nlit = read(5) + 257, ndist = read(5) + 1, ncode = read(4) + 4;
+                static const int order[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+                std::vector<int> codeLengths(19, 0);
+                for (int k = 0; k < ncode; ++k) {
+                    codeLengths[order[k]] = read(3);
+                }
+                Huffman lengthCode = build(codeLengths);
+                std::vector<int> lengths;
+                while ((int)lengths.size() < nlit + ndist) {
+                    int symbol = decode(lengthCode);
+                    if (symbol < 16) {
+                        lengths.push_back(symbol);
+                    } else if (symbol == 16) {
+                        int repeat = 3 + read(2);
+                        lengths.insert(lengths.end(), repeat, lengths.back());
+                    } else {
+                        int repeat = symbol == 17 ? 3 + read(3) : 11 + read(7);
+                        lengths.insert(lengths.end(), repeat, 0);
+                    }
+                }
+                literalLengths.assign(lengths.begin(), lengths.begin() + nlit);
+                distanceLengths.assign(lengths.begin() + nlit, lengths.end());
+            }
+
+            Huffman literals = build(literalLengths), distances = build(distanceLengths);
+            for (;;) {
+                int symbol = decode(literals);
+                if (symbol < 256) {
+                    out.push_back((char)symbol);
+                } else if (symbol == 256) {
+                    break;
+                } else {
+                    symbol -= 257;
+                    int length = lengthBase[symbol] + read(lengthExtra[symbol]);
+                    int d = decode(distances);
+                    size_t distance = distanceBase[d] + read(distanceExtra[d]);
+                    assert(distance <= out.size());
+                    for (int k = 0; k < length; ++k) {
+                        out.push_back(out[out.size() - distance]);
+                    }
+                }
+            }
+        } while (!final);
+
+        count = 0;
+        uint32_t crc = 0, size = 0;
+        for (int k = 0; k < 4; ++k) {
+            crc |= (uint32_t)(uint8_t)in[pos + k] << (8 * k);
+            size |= (uint32_t)(uint8_t)in[pos + 4 + k] << (8 * k);
+        }
+        assert(pos + 8 == in.size());
+        assert(crc == crc32_update(0, (const uint8_t*)out.data(), out.size()));
+        assert(size == (uint32_t)out.size());
+        return out;
+    }
+};
+
+std::string gzip(const std::string& text, const GzipOptions& options) {
+    std::ostringstream sink;
+    GzipOStream out(sink, options);
+    out << text;
+    bool ok = out.finish();
+    assert(ok);
+    return sink.str();
+}
+
+void test_crc32() {
+    const char* check = "123456789";
+    assert(crc32_update(0, (const uint8_t*)check, 9) == 0xCBF43926u);
+    // Incremental updates give the same checksum
+    uint32_t crc = crc32_update(0, (const uint8_t*)check, 4);
+    assert(crc32_update(crc, (const uint8_t*)check + 4, 5) == 0xCBF43926u);
+}
+
+void test_round_trip() {
+    Canvas canvas = create_canvas(30, 30);
+    std::vector<Transform> transforms = {{"rotate", 30}, {"scale", 0.8}};
+    RenderOptions renderOptions;
+    renderOptions.seed = 5;
+    std::string svg = canvas_list_transform_simpleObject_to_svg(canvas, transforms, -1, renderOptions);
+    std::string html = create_html_wrapper(svg, "Compressed");
+
+    std::vector<std::string> inputs = {"", "a", std::string(100000, 'x'), svg, html};
+    for (int level : {0, 1, 6, 9}) {
+        for (size_t bufferSize : {(size_t)1024, (size_t)1 << 16}) {
+            GzipOptions options;
+            options.level = level;
+            options.bufferSize = bufferSize;
+            for (const auto& input : inputs) {
+                std::string compressed = gzip(input, options);
+                assert(Inflater(compressed).gunzip() == input);
+
+                // The compressor thread produces the same bytes
+                options.thread = true;
+                assert(gzip(input, options) == compressed);
+                options.thread = false;
+            }
+        }
+    }
+}
+
+// Checks against a decoder that is not part of this test: zlib's inflate
+// when it is linked, otherwise output of the built-in encoder that zlib has
+// decoded to the same text
+void test_independent_decoder() {
+#ifdef ALMIGHTY_ZLIB
+    Canvas canvas = create_canvas(30, 30);
+    RenderOptions renderOptions;
+    renderOptions.seed = 8;
+    std::string input = canvas_list_transform_simpleObject_to_svg(canvas, {{"rotate", 30}}, -1, renderOptions);
+    for (int level : {0, 1, 6, 9}) {
+        GzipOptions options;
+        options.level = level;
+        std::string compressed = gzip(input, options);
+
+        z_stream stream{};
+        int status = inflateInit2(&stream, 15 + 16);
+        assert(status == Z_OK);
+        std::string output(input.size() + 1, '\0');
+        stream.next_in = (Bytef*)compressed.data();
+        stream.avail_in = (uInt)compressed.size();
+        stream.next_out = (Bytef*)&output[0];
+        stream.avail_out = (uInt)output.size();
+        status = inflate(&stream, Z_FINISH);
+        assert(status == Z_STREAM_END && stream.avail_in == 0);
+        output.resize(stream.total_out);
+        inflateEnd(&stream);
+        assert(output == input);
+    }
+#else
+    auto bytes = [](const std::string& hex) {
+        std::string out;
+        for (size_t i = 0; i < hex.size(); i += 2) {
+            out.push_back((char)std::stoi(hex.substr(i, 2), nullptr, 16));
+        }
+        return out;
+    };
+    GzipOptions stored;
+    stored.level = 0;
+    assert(gzip("abc", stored) == bytes("1f8b08000000000000ff010300fcff616263c241243503000000"));
+    GzipOptions fixed;
+    assert(gzip("abc", fixed) == bytes("1f8b08000000000000ff4b4c4a0600c241243503000000"));
+    assert(gzip("abcabcabcabc", fixed) == bytes("1f8b08000000000000ff4b4c4a862300342a6e5a0c000000"));
+#endif
+}
+
+// Flushing line by line (std::endl) gives the same bytes as one write
+void test_flush_does_not_split_blocks() {
+    Canvas canvas = create_canvas(20, 20);
+    RenderOptions renderOptions;
+    renderOptions.seed = 4;
+    std::string svg = canvas_list_transform_simpleObject_to_svg(canvas, {{"rotate", 30}}, -1, renderOptions);
+    for (bool thread : {false, true}) {
+        GzipOptions options;
+        options.thread = thread;
+        std::ostringstream sink;
+        GzipOStream out(sink, options);
+        std::istringstream lines(svg);
+        std::string line;
+        while (std::getline(lines, line)) {
+            out << line << std::endl;
+        }
+        bool ok = out.finish();
+        assert(ok);
+        std::string whole = svg.back() == '\n' ? svg : svg + "\n";
+        assert(sink.str() == gzip(whole, options));
+    }
+}
+
+void test_streamed_render() {
+    Canvas canvas = create_canvas(60, 60);
+    std::vector<Transform> transforms = {{"rotate", 45}, {"scale", 0.7}};
+    RenderOptions renderOptions;
+    renderOptions.seed = 2;
+    std::string svg = canvas_list_transform_simpleObject_to_svg(canvas, transforms, -1, renderOptions);
+
+    // Rendered straight into the compressed stream, never as one string
+    GzipOptions options;
+    options.thread = true;
+    assert(write_gzip_file("gzip_stream.svgz", [&](std::ostream& out) {
+        write_svg_header(out, canvas.width, canvas.height);
+        canvas_list_transform_simpleObject_write(out, canvas, transforms, -1, renderOptions);
+        write_svg_footer(out);
+    }, options));
+    std::string compressed = read_file("gzip_stream.svgz");
+    assert(Inflater(compressed).gunzip() == svg);
+
+    assert(write_gzip_file("gzip_stream.html.gz", [&](std::ostream& out) {
+        write_html_header(out, "Compressed");
+        out << svg;
+        write_html_footer(out);
+    }));
+    assert(Inflater(read_file("gzip_stream.html.gz")).gunzip() == create_html_wrapper(svg, "Compressed"));
+
+    assert(is_gzip_path("a.svgz") && is_gzip_path("a.html.gz") && !is_gzip_path("a.svg") && !is_gzip_path("gz"));
+    assert(!write_gzip_file("missing_directory/out.svgz", [](std::ostream& out) { out << "x"; }));
+}
+
+void test_merge_shards_compressed() {
+    Canvas canvas = create_canvas(12, 10);
+    ShardRenderer renderer = [&](std::ostream& out, const RenderOptions& options) {
+        canvas_list_transform_simpleObject_write(out, canvas, {{"rotate", 20}}, -1, options);
+    };
+    RenderOptions options;
+    options.seed = 9;
+    assert(render_sharded(canvas, renderer, options, 3, 2, ".", "gzip_sharded.svg"));
+    assert(render_sharded(canvas, renderer, options, 3, 2, ".", "gzip_sharded.svgz"));
+    assert(Inflater(read_file("gzip_sharded.svgz")).gunzip() == read_file("gzip_sharded.svg"));
+}
+
+void test_throughput() {
+    Canvas canvas = create_canvas(200, 200);
+    std::vector<Transform> transforms = {{"rotate", 45}, {"scale", 0.8}};
+    RenderOptions renderOptions;
+    renderOptions.seed = 1;
+    std::ostringstream plain;
+    canvas_list_transform_simpleObject_write(plain, canvas, transforms, -1, renderOptions);
+    std::string svg = plain.str();
+
+    for (int level : {1, 6, 9}) {
+        GzipOptions options;
+        options.level = level;
+        auto start = std::chrono::steady_clock::now();
+        std::string compressed = gzip(svg, options);
+        auto done = std::chrono::steady_clock::now();
+        double ms = std::chrono::duration<double, std::milli>(done - start).count();
+        std::cout << "level " << level << ": " << svg.size() << " -> " << compressed.size() << " bytes ("
+                  << (double)svg.size() / compressed.size() << "x), " << svg.size() / 1e3 / ms << " MB/s" << std::endl;
+        assert(compressed.size() * 5 < svg.size());
+    }
+}
+
+int main() {
+    test_crc32();
+    test_round_trip();
+    test_independent_decoder();
+    test_flush_does_not_split_blocks();
+    test_streamed_render();
+    test_merge_shards_compressed();
+    test_throughput();
+    std::cout << "Gzip stream tests passed" << std::endl;
+    return 0;
+}
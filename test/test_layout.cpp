@@ -0,0 +1,142 @@
+#include "../include/canvas.hpp"
+#include "../include/layout.hpp"
+#include "../include/svg_utils.hpp"
+#include <cassert>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <set>
+
+// Create a square centered on the origin
+Object create_square(double size, const std::string& color) {
+    Object obj;
+    obj.points = {
+        {-size / 2, -size / 2},
+        {size / 2, -size / 2},
+        {size / 2, size / 2},
+        {-size / 2, size / 2}
+    };
+    obj.color = color;
+    return obj;
+}
+
+Canvas create_canvas(int rows, int cols) {
+    Canvas canvas;
+    canvas.width = 800;
+    canvas.height = 600;
+    canvas.baseObject = {create_square(20, "blue")};
+    canvas.rows = rows;
+    canvas.cols = cols;
+    return canvas;
+}
+
+void test_grid_matches_renderer() {
+    Canvas canvas = create_canvas(3, 4);
+    std::vector<Cell> cells = grid_layout(canvas);
+    assert(cells.size() == 12);
+    assert(cells[0].row == 0 && cells[0].col == 0);
+    assert(cells[5].row == 1 && cells[5].col == 1);
+    assert(cells[5].center.x == 2 * (800 / 5) && cells[5].center.y == 2 * (600 / 4));
+}
+
+void test_jittered_is_deterministic() {
+    Canvas canvas = create_canvas(10, 10);
+    Layout layout;
+    layout.type = "jittered";
+    layout.seed = 42;
+
+    std::vector<Cell> a = layout_cells(canvas, layout);
+    std::vector<Cell> b = layout_cells(canvas, layout);
+    std::vector<Cell> grid = grid_layout(canvas);
+    for (size_t k = 0; k < a.size(); ++k) {
+        assert(a[k].center.x == b[k].center.x && a[k].center.y == b[k].center.y);
+        assert(std::fabs(a[k].center.x - grid[k].center.x) <= 0.5 * 800 / 11.0 / 2.0);
+    }
+}
+
+void test_poisson_min_distance() {
+    Canvas canvas = create_canvas(20, 20);
+    Layout layout;
+    layout.type = "poisson";
+    layout.minDistance = 15;
+    layout.seed = 7;
+
+    std::vector<Cell> cells = layout_cells(canvas, layout);
+    assert(cells.size() > 100);
+
+    // Checked with the spatial hash itself, against a brute-force pass on a prefix
+    SpatialHash hash(800, 600, layout.minDistance);
+    for (const auto& cell : cells) {
+        assert(!hash.any_within(cell.center, layout.minDistance - 1e-9));
+        hash.insert(cell.center);
+    }
+    for (size_t i = 0; i < 200 && i < cells.size(); ++i) {
+        for (size_t j = i + 1; j < cells.size(); ++j) {
+            double dx = cells[i].center.x - cells[j].center.x;
+            double dy = cells[i].center.y - cells[j].center.y;
+            assert(std::sqrt(dx * dx + dy * dy) >= layout.minDistance - 1e-9);
+        }
+    }
+
+    // Ordered by row for band-wise consumers
+    for (size_t k = 1; k < cells.size(); ++k) {
+        assert(cells[k - 1].row <= cells[k].row);
+    }
+}
+
+// Poisson samples can share a row/col, but ids stay unique and do not
+// depend on the row band
+void test_cell_ids_are_unique() {
+    Canvas canvas = create_canvas(20, 60);
+    const char* types[] = {"grid", "hex", "jittered", "poisson"};
+    for (const char* type : types) {
+        Layout layout;
+        layout.type = type;
+        layout.seed = 3;
+        std::vector<Cell> cells = layout_cells(canvas, layout);
+        std::set<int> ids;
+        std::set<std::pair<int, int>> rowCols;
+        for (size_t k = 0; k < cells.size(); ++k) {
+            assert(cells[k].id == (int)k);
+            ids.insert(cells[k].id);
+            rowCols.insert({cells[k].row, cells[k].col});
+        }
+        assert(ids.size() == cells.size());
+        if (std::string(type) == "poisson") {
+            assert(rowCols.size() < cells.size());
+            assert(cell_seed(1, cells[0]) != cell_seed(1, cells[1]));
+        }
+
+        std::vector<Cell> band = layout_cells(canvas, layout, 5, 9);
+        assert(!band.empty());
+        for (const auto& cell : band) {
+            assert(cells[cell.id].row == cell.row && cells[cell.id].center.x == cell.center.x);
+        }
+    }
+}
+
+void test_render_layouts() {
+    Canvas canvas = create_canvas(8, 10);
+    const char* types[] = {"grid", "hex", "jittered", "poisson"};
+    for (const char* type : types) {
+        RenderOptions options;
+        options.layout.type = type;
+        std::string svg = canvas_transform_composed_to_svg(canvas, {{"rotate", 30}}, options);
+
+        std::ofstream file(std::string("layout_") + type + ".html");
+        if (file.is_open()) {
+            file << create_html_wrapper(svg, std::string("Layout - ") + type);
+            file.close();
+        }
+    }
+}
+
+int main() {
+    test_grid_matches_renderer();
+    test_jittered_is_deterministic();
+    test_poisson_min_distance();
+    test_cell_ids_are_unique();
+    test_render_layouts();
+    std::cout << "Layout tests passed" << std::endl;
+    return 0;
+}
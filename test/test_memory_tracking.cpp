@@ -0,0 +1,109 @@
+#include "../include/canvas.hpp"
+#include "../include/memory_stats.hpp"
+#include "../include/svg_utils.hpp"
+#include <cassert>
+#include <iostream>
+
+// Must be built with -DALMIGHTY_MEMORY_TRACKING (library and test); without it
+// the test fails rather than passing without checking anything.
+// The bounds are upper limits for the current hot paths: lower them when an
+// optimization lands, never raise them without a reason.
+
+Object create_square(double size, const std::string& color) {
+    Object obj;
+    obj.points = {
+        {-size / 2, -size / 2},
+        {size / 2, -size / 2},
+        {size / 2, size / 2},
+        {-size / 2, size / 2}
+    };
+    obj.color = color;
+    return obj;
+}
+
+Canvas create_vera_canvas(int rows, int cols) {
+    Canvas canvas;
+    canvas.width = 800;
+    canvas.height = 600;
+    canvas.baseObject = {
+        create_square(60, "blue"),
+        create_square(40, "red"),
+        create_square(30, "red"),
+        create_square(20, "blue")
+    };
+    canvas.rows = rows;
+    canvas.cols = cols;
+    return canvas;
+}
+
+void check_report(const RenderMemoryReport& report, double maxPerCell, double maxPerVertex) {
+    std::cout << memory_report_to_string(report);
+    assert(report.cells > 0);
+    assert(report.vertices == report.cells * 16);
+    assert(report.allocations_per_cell() <= maxPerCell);
+    assert(report.allocations_per_vertex() <= maxPerVertex);
+    assert(report.stage("layout") != nullptr);
+    assert(report.stage("transform") != nullptr);
+    assert(report.stage("serialize") != nullptr);
+    assert(report.total.peakLiveBytes >= report.stage("serialize")->peakLiveBytes);
+}
+
+void test_composed() {
+    Canvas canvas = create_vera_canvas(20, 20);
+    std::string svg = canvas_composed_to_svg(canvas);
+    const RenderMemoryReport& report = memory_last_report();
+    assert(std::string(report.call) == "canvas_composed_to_svg");
+    check_report(report, 36, 2.25);
+
+    // Layout is a single allocation for the whole grid
+    assert(report.stage("layout")->allocations <= 2);
+    // Transform copies one vector per object plus the outer vector
+    assert(report.stage("transform")->allocations <= 5 * report.cells);
+}
+
+void test_transform_composed() {
+    Canvas canvas = create_vera_canvas(20, 20);
+    std::string svg = canvas_transform_composed_to_svg(canvas, {{"rotate", 45}, {"scale", 1.2}});
+    check_report(memory_last_report(), 36, 2.25);
+}
+
+void test_list_transform() {
+    Canvas canvas = create_vera_canvas(20, 20);
+    std::vector<Transform> transforms = {{"rotate", 45}, {"scale", 0.8}};
+    std::string svg = canvas_list_transform_simpleObject_to_svg(canvas, transforms);
+    check_report(memory_last_report(), 36, 2.25);
+}
+
+// Compact path output writes through a stack buffer: one scratch vector per object
+void test_path_geometry() {
+    Canvas canvas = create_vera_canvas(20, 20);
+    RenderOptions options;
+    options.geometry = "path";
+    std::string svg = canvas_transform_composed_to_svg(canvas, {{"rotate", 45}}, options);
+    const RenderMemoryReport& report = memory_last_report();
+    check_report(report, 12, 0.75);
+    assert(report.stage("serialize")->allocations <= 4 * report.cells + 32);
+}
+
+void test_live_bytes_released() {
+    uint64_t before = memory_live_bytes();
+    {
+        Canvas canvas = create_vera_canvas(10, 10);
+        std::string svg = canvas_composed_to_svg(canvas);
+    }
+    assert(memory_live_bytes() == before);
+}
+
+int main() {
+    if (!memory_tracking_enabled()) {
+        std::cerr << "Error: Memory tracking not compiled in; build with -DALMIGHTY_MEMORY_TRACKING" << std::endl;
+        return 1;
+    }
+    test_composed();
+    test_transform_composed();
+    test_list_transform();
+    test_path_geometry();
+    test_live_bytes_released();
+    std::cout << "Memory tracking tests passed" << std::endl;
+    return 0;
+}
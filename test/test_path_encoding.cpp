@@ -0,0 +1,162 @@
+#include "../include/canvas.hpp"
+#include "../include/svg_utils.hpp"
+#include <cassert>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Minimal path data parser (M, m, L, l, H, h, V, v, Z, z) for the round trip
+std::vector<Point> parse_path(const std::string& d) {
+    std::vector<Point> points;
+    Point current{0, 0};
+    char command = 0;
+    size_t pos = 0;
+
+    auto skip = [&]() {
+        while (pos < d.size() && (std::isspace((unsigned char)d[pos]) || d[pos] == ',')) ++pos;
+    };
+    auto number = [&]() {
+        skip();
+        const char* begin = d.c_str() + pos;
+        char* end = nullptr;
+        double value = std::strtod(begin, &end);
+        assert(end != begin);
+        pos += end - begin;
+        return value;
+    };
+
+    while (true) {
+        skip();
+        if (pos >= d.size()) break;
+        if (std::isalpha((unsigned char)d[pos])) {
+            command = d[pos++];
+            if (command == 'z' || command == 'Z') continue;
+        }
+        switch (command) {
+        case 'M': case 'L': current.x = number(); current.y = number(); break;
+        case 'm': case 'l': current.x += number(); current.y += number(); break;
+        case 'H': current.x = number(); break;
+        case 'h': current.x += number(); break;
+        case 'V': current.y = number(); break;
+        case 'v': current.y += number(); break;
+        default: assert(false);
+        }
+        points.push_back(current);
+    }
+    return points;
+}
+
+std::string path_data(const std::string& element) {
+    size_t begin = element.find("d=\"") + 3;
+    return element.substr(begin, element.find('"', begin) - begin);
+}
+
+double distance_to_segment(Point p, Point a, Point b) {
+    double dx = b.x - a.x, dy = b.y - a.y;
+    double len2 = dx * dx + dy * dy;
+    double t = len2 > 0 ? ((p.x - a.x) * dx + (p.y - a.y) * dy) / len2 : 0;
+    t = std::max(0.0, std::min(1.0, t));
+    double ex = a.x + t * dx - p.x, ey = a.y + t * dy - p.y;
+    return std::sqrt(ex * ex + ey * ey);
+}
+
+double distance_to_polygon(Point p, const std::vector<Point>& polygon) {
+    double best = 1e300;
+    for (size_t i = 0; i < polygon.size(); ++i) {
+        best = std::min(best, distance_to_segment(p, polygon[i], polygon[(i + 1) % polygon.size()]));
+    }
+    return best;
+}
+
+// Every original vertex must stay within half a quantum diagonal of the decoded outline
+void check_round_trip(const Object& obj, double quantum) {
+    std::vector<Point> decoded = parse_path(path_data(object_to_svg_path(obj, quantum)));
+    double bound = quantum * std::sqrt(0.5) + 1e-9;
+    assert(!decoded.empty());
+    for (const auto& point : obj.points) {
+        assert(distance_to_polygon(point, decoded) <= bound);
+    }
+    for (const auto& point : decoded) {
+        assert(distance_to_polygon(point, obj.points) <= bound);
+    }
+}
+
+void test_round_trip() {
+    std::mt19937 gen(11);
+    std::uniform_real_distribution<double> coord(-500, 500);
+    for (double quantum : {0.01, 0.001, 0.25, 1.0}) {
+        for (int n = 0; n < 200; ++n) {
+            Object obj;
+            obj.color = "red";
+            for (int k = 0; k < 3 + n % 9; ++k) {
+                obj.points.push_back({coord(gen), coord(gen)});
+            }
+            check_round_trip(obj, quantum);
+        }
+    }
+
+    // Axis-aligned and collinear input
+    Object square{{{0, 0}, {5, 0}, {10, 0}, {10, 10}, {0, 10}, {0, 5}}, "blue"};
+    assert(object_to_svg_path(square) == "<path d=\"M0 0h10v10h-10z\" fill=\"blue\"/>\n");
+    check_round_trip(square, 0.01);
+}
+
+void test_number_formatting() {
+    Object obj{{{-0.05, 0.5}, {1.234, -7.5}, {3, 3}}, "black"};
+    assert(path_data(object_to_svg_path(obj, 0.01)) == "M-.05.5l1.28-8 1.77 10.5z");
+}
+
+// Star with 10 vertices, the densest shape in the examples
+Object create_star(double size, const std::string& color) {
+    Object obj;
+    for (int i = 0; i < 10; ++i) {
+        double radius = (i % 2 == 0) ? size / 2 : size / 4;
+        double angle = i * M_PI / 5;
+        obj.points.push_back({radius * cos(angle - M_PI / 2), radius * sin(angle - M_PI / 2)});
+    }
+    obj.color = color;
+    return obj;
+}
+
+void test_size_and_speed() {
+    Canvas canvas;
+    canvas.width = 2000;
+    canvas.height = 2000;
+    canvas.baseObject = {create_star(60, "orange")};
+    canvas.rows = 100;
+    canvas.cols = 100;
+
+    std::vector<std::pair<std::string, double>> transforms = {{"rotate", 30}, {"scale", 0.8}};
+    RenderOptions options;
+
+    auto start = std::chrono::steady_clock::now();
+    std::string polygons = canvas_transform_composed_to_svg(canvas, transforms, options);
+    double polygonMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "polygon: " << polygons.size() << " bytes, " << polygonMs << " ms" << std::endl;
+
+    options.geometry = "path";
+    for (double quantum : {0.01, 0.1, 1.0}) {
+        options.quantum = quantum;
+        start = std::chrono::steady_clock::now();
+        std::string paths = canvas_transform_composed_to_svg(canvas, transforms, options);
+        double pathMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        double ratio = (double)polygons.size() / paths.size();
+        std::cout << "path (" << quantum << "): " << paths.size() << " bytes, " << pathMs
+                  << " ms, " << ratio << "x smaller" << std::endl;
+        assert(ratio >= (quantum < 1 ? 1.8 : 2.8));
+    }
+}
+
+int main() {
+    test_round_trip();
+    test_number_formatting();
+    test_size_and_speed();
+    std::cout << "Path encoding tests passed" << std::endl;
+    return 0;
+}
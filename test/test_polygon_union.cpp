@@ -0,0 +1,220 @@
+#include "../include/canvas.hpp"
+#include "../include/geometry.hpp"
+#include "../include/polygon_union.hpp"
+#include "../include/spatial_index.hpp"
+#include "../include/svg_utils.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+// Create a square with its top-left corner at (x, y)
+Object create_square(double x, double y, double size, const std::string& color) {
+    Object obj;
+    obj.points = {{x, y}, {x + size, y}, {x + size, y + size}, {x, y + size}};
+    obj.color = color;
+    return obj;
+}
+
+// Create Vera Molnár style squares, centered on the origin
+std::vector<Object> create_vera_squares() {
+    std::vector<Object> objects;
+    objects.push_back(create_square(-30, -30, 60, "blue"));
+    objects.push_back(create_square(-20, -20, 40, "red"));
+    objects.push_back(create_square(-15, -15, 30, "red"));
+    objects.push_back(create_square(-10, -10, 20, "blue"));
+    return objects;
+}
+
+bool near(double a, double b) {
+    return std::fabs(a - b) < 1e-6;
+}
+
+// Color painted at p, "" for the background
+std::string color_at(const std::vector<Object>& objects, Point p) {
+    for (size_t k = objects.size(); k-- > 0;) {
+        if (point_in_polygon(p, objects[k].points.data(), objects[k].points.size())) {
+            return objects[k].color;
+        }
+    }
+    return "";
+}
+
+size_t count_vertices(const std::vector<Object>& objects) {
+    size_t count = 0;
+    for (const auto& obj : objects) {
+        count += obj.points.size();
+    }
+    return count;
+}
+
+// Parse the polygons back out of SVG output
+std::vector<Object> parse_polygons(const std::string& svg) {
+    std::vector<Object> objects;
+    size_t pos = 0;
+    while ((pos = svg.find("<polygon points=\"", pos)) != std::string::npos) {
+        pos += 17;
+        size_t end = svg.find('"', pos);
+        std::istringstream points(svg.substr(pos, end - pos));
+        Object obj;
+        double x, y;
+        char comma;
+        while (points >> x >> comma >> y) {
+            obj.points.push_back({x, y});
+        }
+        size_t fill = svg.find("fill=\"", end) + 6;
+        obj.color = svg.substr(fill, svg.find('"', fill) - fill);
+        objects.push_back(obj);
+        pos = end;
+    }
+    return objects;
+}
+
+void test_union_shapes() {
+    std::vector<std::vector<Point>> rings;
+
+    // Overlapping squares: an 8-vertex outline
+    assert(polygon_union({create_square(0, 0, 10, "").points, create_square(5, 5, 10, "").points}, rings));
+    assert(rings.size() == 1 && rings[0].size() == 8);
+    assert(near(polygon_area(rings[0]), 175));
+
+    // Squares sharing an edge: one rectangle
+    assert(polygon_union({create_square(0, 0, 10, "").points, create_square(10, 0, 10, "").points}, rings));
+    assert(rings.size() == 1 && rings[0].size() == 4 && near(polygon_area(rings[0]), 200));
+
+    // Partly shared edge, opposite orientation of the inputs
+    std::vector<Point> reversed = create_square(10, 5, 10, "").points;
+    std::reverse(reversed.begin(), reversed.end());
+    assert(polygon_union({create_square(0, 0, 10, "").points, reversed}, rings));
+    assert(rings.size() == 1 && rings[0].size() == 8 && near(polygon_area(rings[0]), 200));
+
+    // Disjoint squares stay separate
+    assert(polygon_union({create_square(0, 0, 10, "").points, create_square(20, 0, 10, "").points}, rings));
+    assert(rings.size() == 2);
+
+    // Four bars around a hole: an outer ring and a hole ring
+    assert(polygon_union({create_square(0, 0, 30, "").points}, rings) && rings.size() == 1);
+    std::vector<std::vector<Point>> frame = {
+        {{0, 0}, {30, 0}, {30, 10}, {0, 10}},
+        {{20, 0}, {30, 0}, {30, 30}, {20, 30}},
+        {{0, 20}, {30, 20}, {30, 30}, {0, 30}},
+        {{0, 0}, {10, 0}, {10, 30}, {0, 30}}
+    };
+    assert(polygon_union(frame, rings) && rings.size() == 2);
+    double area = polygon_area(rings[0]) + polygon_area(rings[1]);
+    assert(near(area, 800));
+
+    // Rotated copies cross properly
+    Object a = create_square(-10, -10, 20, "");
+    Object b = a;
+    apply_transform(b, Transform{"rotate", 30}, {0, 0});
+    assert(polygon_union({a.points, b.points}, rings) && rings.size() == 1 && rings[0].size() == 16);
+
+    assert(polygon_contains(create_square(0, 0, 10, "").points, create_square(2, 2, 5, "").points));
+    assert(polygon_contains(create_square(0, 0, 10, "").points, create_square(0, 0, 10, "").points));
+    assert(!polygon_contains(create_square(0, 0, 10, "").points, create_square(8, 2, 5, "").points));
+}
+
+void test_reduce_cell() {
+    // The inner red square merges into the outer one
+    std::vector<Object> objects = create_vera_squares();
+    reduce_objects(objects);
+    assert(objects.size() == 3);
+    assert(objects[0].color == "blue" && objects[1].color == "red" && objects[2].color == "blue");
+
+    // Hidden under a later square of another color
+    objects = {create_square(2, 2, 5, "green"), create_square(0, 0, 10, "blue")};
+    reduce_objects(objects);
+    assert(objects.size() == 1 && objects[0].color == "blue");
+
+    // A differently colored square in between blocks the merge
+    objects = {create_square(0, 0, 10, "red"), create_square(8, 0, 10, "blue"), create_square(10, 0, 10, "red")};
+    reduce_objects(objects);
+    assert(objects.size() == 3);
+    // ...but not when it only overlaps the part that stays in place
+    objects = {create_square(0, 0, 10, "red"), create_square(-5, 0, 8, "blue"), create_square(10, 0, 10, "red")};
+    reduce_objects(objects);
+    assert(objects.size() == 2 && objects[1].color == "blue" && near(polygon_area(objects[1].points), 64));
+}
+
+void test_reduce_keeps_translucent() {
+    assert(is_opaque_color("red") && is_opaque_color("#0aF") && is_opaque_color("#00ff00"));
+    assert(is_opaque_color("rgb(10, 20, 30)") && is_opaque_color("hsl(120 50% 50%)"));
+    assert(!is_opaque_color("none") && !is_opaque_color("Transparent") && !is_opaque_color("currentColor"));
+    assert(!is_opaque_color("rgba(255,0,0,0.5)") && !is_opaque_color("hsla(0,100%,50%,1)"));
+    assert(!is_opaque_color("rgb(255 0 0 / 50%)") && !is_opaque_color("#ff000080") && !is_opaque_color("#f008"));
+    assert(!is_opaque_color("") && !is_opaque_color("red\" opacity=\"0.5"));
+    assert(is_opaque_color("DarkSlateGrey") && is_opaque_color("yellowgreen"));
+    assert(!is_opaque_color("inherit") && !is_opaque_color("initial") && !is_opaque_color("redd"));
+
+    // An unfilled square does not hide what is under it
+    std::vector<Object> objects = {create_square(2, 2, 5, "red"), create_square(0, 0, 10, "none")};
+    reduce_objects(objects);
+    assert(objects.size() == 2);
+    objects = {create_square(2, 2, 5, "red"), create_square(0, 0, 10, "none\" stroke=\"black")};
+    reduce_objects(objects);
+    assert(objects.size() == 2);
+
+    // Translucent squares darken where they overlap, so they are not merged
+    objects = {create_square(0, 0, 10, "rgba(255,0,0,0.5)"), create_square(5, 5, 10, "rgba(255,0,0,0.5)")};
+    reduce_objects(objects);
+    assert(objects.size() == 2 && objects[0].points.size() == 4 && objects[1].points.size() == 4);
+    objects = {create_square(0, 0, 10, "#ff000080"), create_square(2, 2, 5, "#ff000080")};
+    reduce_objects(objects);
+    assert(objects.size() == 2);
+
+    // A translucent square can still be hidden under an opaque one
+    objects = {create_square(2, 2, 5, "rgba(0,0,255,0.5)"), create_square(0, 0, 10, "blue")};
+    reduce_objects(objects);
+    assert(objects.size() == 1 && objects[0].color == "blue");
+}
+
+void test_reduce_renders_same_image() {
+    Canvas canvas;
+    canvas.width = 800;
+    canvas.height = 600;
+    canvas.baseObject = create_vera_squares();
+    canvas.rows = 8;
+    canvas.cols = 10;
+    std::vector<Transform> transforms = {{"rotate", 45}, {"scale", 1.4}, {"rotate", 20}};
+
+    std::ofstream html("polygon_union.html");
+    const char* modes[] = {"cell", "canvas"};
+    for (const char* mode : modes) {
+        RenderOptions options;
+        options.seed = 12;
+        std::string plain = canvas_list_transform_simpleObject_to_svg(canvas, transforms, -1, options);
+        options.reduce = mode;
+        std::string reduced = canvas_list_transform_simpleObject_to_svg(canvas, transforms, -1, options);
+
+        std::vector<Object> before = parse_polygons(plain);
+        std::vector<Object> after = parse_polygons(reduced);
+        assert(after.size() < before.size() && count_vertices(after) < count_vertices(before));
+
+        std::mt19937 rng(4);
+        std::uniform_real_distribution<double> x(0, 800), y(0, 600);
+        for (int k = 0; k < 20000; ++k) {
+            Point p{x(rng), y(rng)};
+            assert(color_at(before, p) == color_at(after, p));
+        }
+        std::cout << mode << ": " << before.size() << " -> " << after.size() << " polygons, "
+                  << count_vertices(before) << " -> " << count_vertices(after) << " vertices, "
+                  << plain.size() << " -> " << reduced.size() << " bytes" << std::endl;
+
+        if (html.is_open()) {
+            html << create_html_wrapper(reduced, std::string("Reduced - ") + mode);
+        }
+    }
+}
+
+int main() {
+    test_union_shapes();
+    test_reduce_cell();
+    test_reduce_keeps_translucent();
+    test_reduce_renders_same_image();
+    std::cout << "Polygon union tests passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,278 @@
+#include "../include/canvas.hpp"
+#include "../include/preview_server.hpp"
+#include "../include/svg_utils.hpp"
+#include <arpa/inet.h>
+#include <cassert>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+// Create a square centered on the origin
+Object create_square(double size, const std::string& color) {
+    Object obj;
+    obj.points = {
+        {-size / 2, -size / 2},
+        {size / 2, -size / 2},
+        {size / 2, size / 2},
+        {-size / 2, size / 2}
+    };
+    obj.color = color;
+    return obj;
+}
+
+Canvas create_canvas(int rows, int cols) {
+    Canvas canvas;
+    canvas.width = cols * 20;
+    canvas.height = rows * 20;
+    canvas.baseObject = {create_square(12, "blue")};
+    canvas.rows = rows;
+    canvas.cols = cols;
+    return canvas;
+}
+
+const std::vector<Transform> kTransforms = {{"rotate", 30}, {"scale", 0.7}};
+
+PreviewScene create_scene(int rows, int cols, const std::string& layout = "jittered") {
+    PreviewScene scene;
+    scene.canvas = create_canvas(rows, cols);
+    scene.options.layout.type = layout;
+    scene.options.layout.seed = 17;
+    scene.renderer = [canvas = scene.canvas](std::ostream& out, const RenderOptions& options) {
+        canvas_list_transform_simpleObject_write(out, canvas, kTransforms, -1, options);
+    };
+    return scene;
+}
+
+std::string expected_svg(const PreviewScene& scene, uint64_t seed) {
+    RenderOptions options = scene.options;
+    options.seed = seed;
+    return canvas_list_transform_simpleObject_to_svg(scene.canvas, kTransforms, -1, options);
+}
+
+int connect_to(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    int ok = connect(fd, (sockaddr*)&addr, sizeof(addr));
+    assert(ok == 0);
+    (void)ok;
+    return fd;
+}
+
+void send_all(int fd, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, 0);
+        assert(n > 0);
+        sent += n;
+    }
+}
+
+std::string read_all(int fd) {
+    std::string data;
+    char buffer[65536];
+    ssize_t n;
+    while ((n = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+        data.append(buffer, n);
+    }
+    return data;
+}
+
+struct Response {
+    std::string head;
+    std::string body;
+};
+
+// Split a stream of responses, decoding chunked bodies
+std::vector<Response> parse_responses(const std::string& data) {
+    std::vector<Response> responses;
+    size_t pos = 0;
+    while (pos < data.size()) {
+        size_t end = data.find("\r\n\r\n", pos);
+        assert(end != std::string::npos);
+        Response r;
+        r.head = data.substr(pos, end - pos);
+        pos = end + 4;
+        size_t length = r.head.find("Content-Length: ");
+        if (length != std::string::npos) {
+            size_t size = std::strtoul(r.head.c_str() + length + 16, nullptr, 10);
+            r.body = data.substr(pos, size);
+            pos += size;
+        } else {
+            for (;;) {
+                size_t lineEnd = data.find("\r\n", pos);
+                size_t size = std::strtoul(data.substr(pos, lineEnd - pos).c_str(), nullptr, 16);
+                pos = lineEnd + 2;
+                if (size == 0) {
+                    pos += 2;
+                    break;
+                }
+                r.body += data.substr(pos, size);
+                pos += size + 2;
+            }
+        }
+        responses.push_back(r);
+    }
+    return responses;
+}
+
+Response get(int port, const std::string& target) {
+    int fd = connect_to(port);
+    send_all(fd, "GET " + target + " HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n");
+    std::vector<Response> responses = parse_responses(read_all(fd));
+    close(fd);
+    assert(responses.size() == 1);
+    return responses[0];
+}
+
+bool has_header(const Response& r, const std::string& header) {
+    return r.head.find(header) != std::string::npos;
+}
+
+void test_render_cache() {
+    RenderCache cache(10);
+    cache.put("a", "12345");
+    cache.put("b", "1234");
+    assert(cache.get("a") && *cache.get("a") == "12345");
+    cache.put("c", "123");  // evicts b, the least recently used
+    assert(!cache.get("b") && cache.get("a") && cache.get("c"));
+    cache.put("d", std::string(11, 'x'));  // too large to keep
+    assert(!cache.get("d") && cache.bytes == 8);
+}
+
+void test_server(PreviewServer& server) {
+    int port = server.port();
+    const PreviewScene& small = *server.find_scene("small");
+
+    // Streamed render matches the single-pass renderer, then comes from the cache
+    Response first = get(port, "/scene/small.svg?seed=42");
+    assert(first.head.compare(0, 15, "HTTP/1.1 200 OK") == 0);
+    assert(has_header(first, "Transfer-Encoding: chunked") && has_header(first, "X-Cache: miss"));
+    assert(first.body == expected_svg(small, 42));
+    Response second = get(port, "/scene/small.svg?seed=42");
+    assert(has_header(second, "X-Cache: hit") && second.body == first.body);
+
+    Response html = get(port, "/scene/small?seed=42");
+    assert(html.body == create_html_wrapper(first.body, "Preview - small"));
+    assert(get(port, "/").body.find("/scene/small") != std::string::npos);
+    assert(get(port, "/scene/missing").head.compare(0, 12, "HTTP/1.1 404") == 0);
+    assert(get(port, "/scene/small?seed=x").head.compare(0, 12, "HTTP/1.1 400") == 0);
+
+    // HTTP/1.0 has no chunked encoding: the streamed body ends with the
+    // connection, even when keep-alive was asked for
+    int fd = connect_to(port);
+    send_all(fd, "GET /scene/small.svg?seed=7 HTTP/1.0\r\nConnection: keep-alive\r\n\r\n");
+    std::string raw = read_all(fd);
+    close(fd);
+    size_t headEnd = raw.find("\r\n\r\n");
+    std::string head = raw.substr(0, headEnd);
+    assert(head.find("Transfer-Encoding") == std::string::npos && head.find("Content-Length") == std::string::npos);
+    assert(head.find("Connection: close") != std::string::npos);
+    assert(raw.substr(headEnd + 4) == expected_svg(small, 7));
+    // Cached documents have a known length
+    fd = connect_to(port);
+    send_all(fd, "GET /scene/small.svg?seed=7 HTTP/1.0\r\n\r\n");
+    std::vector<Response> cached = parse_responses(read_all(fd));
+    close(fd);
+    assert(cached.size() == 1 && has_header(cached[0], "Content-Length: ") && cached[0].body == expected_svg(small, 7));
+
+    // Keep-alive with pipelined requests on one connection
+    fd = connect_to(port);
+    send_all(fd, "GET /scene/small.svg?seed=1 HTTP/1.1\r\n\r\nGET /scene/small.svg?seed=2 HTTP/1.1\r\nConnection: close\r\n\r\n");
+    std::vector<Response> responses = parse_responses(read_all(fd));
+    close(fd);
+    assert(responses.size() == 2);
+    assert(responses[0].body == expected_svg(small, 1) && responses[1].body == expected_svg(small, 2));
+
+    // Concurrent clients on the large scene each get their own seed
+    const PreviewScene& large = *server.find_scene("large");
+    std::vector<std::string> bodies(8);
+    std::vector<std::thread> clients;
+    for (int k = 0; k < (int)bodies.size(); ++k) {
+        clients.emplace_back([&, k]() { bodies[k] = get(port, "/scene/large.svg?seed=" + std::to_string(k + 1)).body; });
+    }
+    for (auto& client : clients) {
+        client.join();
+    }
+    for (int k = 0; k < (int)bodies.size(); ++k) {
+        assert(bodies[k] == expected_svg(large, k + 1));
+    }
+
+    // Poisson layouts are generated once per response, not once per band
+    const PreviewScene& poisson = *server.find_scene("poisson");
+    auto ms = [](auto a, auto b) { return std::chrono::duration<double, std::milli>(b - a).count(); };
+    auto start = std::chrono::steady_clock::now();
+    std::string single = expected_svg(poisson, 5);
+    auto rendered = std::chrono::steady_clock::now();
+    assert(get(port, "/scene/poisson.svg?seed=5").body == single);
+    auto streamed = std::chrono::steady_clock::now();
+    std::cout << "Poisson scene: single render " << ms(start, rendered) << " ms, streamed in "
+              << poisson.canvas.rows / 4 << " bands " << ms(rendered, streamed) << " ms" << std::endl;
+
+    // Time to first byte against the time to the whole document
+    start = std::chrono::steady_clock::now();
+    fd = connect_to(port);
+    send_all(fd, "GET /scene/large.svg?seed=100 HTTP/1.1\r\nConnection: close\r\n\r\n");
+    char byte;
+    ssize_t n = recv(fd, &byte, 1, 0);
+    assert(n == 1);
+    (void)n;
+    auto firstByte = std::chrono::steady_clock::now();
+    std::string rest = read_all(fd);
+    auto done = std::chrono::steady_clock::now();
+    close(fd);
+
+    std::cout << "Large scene (" << large.canvas.rows * large.canvas.cols << " cells, " << rest.size() + 1
+              << " bytes): first byte " << ms(start, firstByte) << " ms, complete " << ms(start, done) << " ms" << std::endl;
+
+    // Replacing a scene mid-stream: the response in flight keeps the old
+    // scene, later requests get the new one rather than its cached documents
+    std::shared_ptr<const PreviewScene> before = server.find_scene("large");
+    PreviewScene replacement = create_scene(300, 300);
+    replacement.options.layout.seed = 18;
+    fd = connect_to(port);
+    send_all(fd, "GET /scene/large.svg?seed=200 HTTP/1.1\r\nConnection: close\r\n\r\n");
+    n = recv(fd, &byte, 1, 0);
+    assert(n == 1);
+    server.add_scene("large", replacement);
+    std::vector<Response> replaced = parse_responses(std::string(1, byte) + read_all(fd));
+    close(fd);
+    assert(replaced.size() == 1 && replaced[0].body == expected_svg(*before, 200));
+    Response after = get(port, "/scene/large.svg?seed=200");
+    assert(has_header(after, "X-Cache: miss") && after.body == expected_svg(replacement, 200));
+    assert(after.body != replaced[0].body);
+
+    std::ofstream file("preview_server.html");
+    if (file.is_open()) {
+        file << html.body;
+        file.close();
+    }
+}
+
+int main() {
+    test_render_cache();
+
+    PreviewServerConfig config;
+    config.port = 0;
+    PreviewServer server(config);
+    server.add_scene("small", create_scene(6, 8));
+    server.add_scene("large", create_scene(300, 300));
+    server.add_scene("poisson", create_scene(200, 200, "poisson"));
+    if (!server.start()) {
+        return 1;
+    }
+    std::thread loop([&]() { server.run(); });
+    test_server(server);
+    server.stop();
+    loop.join();
+
+    std::cout << "Preview server tests passed" << std::endl;
+    return 0;
+}
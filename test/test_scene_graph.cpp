@@ -0,0 +1,94 @@
+#include "../include/canvas.hpp"
+#include "../include/geometry.hpp"
+#include "../include/scene.hpp"
+#include "../include/svg_utils.hpp"
+#include <cassert>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+
+// Create a square centered on the origin
+Object create_square(double size, const std::string& color) {
+    Object obj;
+    obj.points = {
+        {-size / 2, -size / 2},
+        {size / 2, -size / 2},
+        {size / 2, size / 2},
+        {-size / 2, size / 2}
+    };
+    obj.color = color;
+    return obj;
+}
+
+// Vera Molnár nested squares as groups: the two red squares rotate together
+void build_vera_cell(SceneNode* cell) {
+    cell->add_object(create_square(60, "blue"));
+
+    SceneNode* middle = cell->add_child("middle");
+    middle->add_object(create_square(40, "red"));
+    middle->add_object(create_square(30, "red"));
+
+    SceneNode* inner = middle->add_child("inner");
+    inner->add_object(create_square(20, "blue"));
+}
+
+void test_world_cache() {
+    SceneNode root("root");
+    SceneNode* cell = root.add_child("cell");
+    build_vera_cell(cell);
+    SceneNode* middle = cell->children()[0].get();
+    SceneNode* inner = middle->children()[0].get();
+
+    cell->set_local(matrix_translate(100, 50));
+    Point p = matrix_apply(inner->world(), {0, 0});
+    assert(p.x == 100 && p.y == 50);
+    assert(!inner->dirty() && !middle->dirty() && !cell->dirty());
+
+    // Changing a group only invalidates its own subtree
+    middle->apply(Transform{"rotate", 45}, {0, 0});
+    assert(!cell->dirty());
+    assert(middle->dirty() && inner->dirty());
+
+    Point q = matrix_apply(inner->world(), {10, 0});
+    assert(std::fabs(q.x - (100 + 10 * std::cos(M_PI / 4))) < 1e-9);
+    assert(std::fabs(q.y - (50 + 10 * std::sin(M_PI / 4))) < 1e-9);
+}
+
+void test_flatten_matches_canvas() {
+    Canvas canvas;
+    canvas.width = 800;
+    canvas.height = 600;
+    canvas.baseObject = {create_square(50, "blue")};
+    canvas.rows = 2;
+    canvas.cols = 3;
+
+    auto scene = scene_from_canvas(canvas);
+    std::string flat = scene_to_svg(*scene, canvas.width, canvas.height, true);
+    assert(flat == canvas_composed_to_svg(canvas));
+}
+
+void test_vera_scene() {
+    SceneNode root("vera");
+    for (int i = 0; i < 2; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            SceneNode* cell = root.add_child();
+            build_vera_cell(cell);
+            cell->set_local(matrix_translate((j + 1) * 200, (i + 1) * 200));
+            cell->children()[0]->apply(Transform{"rotate", 15.0 * (i * 3 + j)}, {0, 0});
+        }
+    }
+
+    std::ofstream file("vera_scene_graph.html");
+    if (file.is_open()) {
+        file << create_html_wrapper(scene_to_svg(root, 800, 600), "Vera Molnar - Scene Graph");
+        file.close();
+    }
+}
+
+int main() {
+    test_world_cache();
+    test_flatten_matches_canvas();
+    test_vera_scene();
+    std::cout << "Scene graph tests passed" << std::endl;
+    return 0;
+}
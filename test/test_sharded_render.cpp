@@ -0,0 +1,100 @@
+#include "../include/canvas.hpp"
+#include "../include/geometry.hpp"
+#include "../include/shard.hpp"
+#include "../include/svg_utils.hpp"
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <sys/stat.h>
+
+// Create a square centered on the origin
+Object create_square(double size, const std::string& color) {
+    Object obj;
+    obj.points = {
+        {-size / 2, -size / 2},
+        {size / 2, -size / 2},
+        {size / 2, size / 2},
+        {-size / 2, size / 2}
+    };
+    obj.color = color;
+    return obj;
+}
+
+std::string read_file(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    std::ostringstream content;
+    content << file.rdbuf();
+    return content.str();
+}
+
+void test_plan_covers_rows() {
+    Canvas canvas;
+    canvas.rows = 10;
+    canvas.cols = 3;
+    std::vector<Shard> shards = plan_shards(canvas, 4, ".");
+    assert(shards.size() == 4);
+    assert(shards.front().rowBegin == 0 && shards.back().rowEnd == 10);
+    for (size_t k = 1; k < shards.size(); ++k) {
+        assert(shards[k].rowBegin == shards[k - 1].rowEnd);
+    }
+    assert(plan_shards(canvas, 50, ".").size() == 10);
+}
+
+// Sharded output must match a single-process render byte for byte
+void test_sharded_matches_single(const std::string& layoutType) {
+    Canvas canvas;
+    canvas.width = 800;
+    canvas.height = 600;
+    canvas.baseObject = {create_square(30, "blue"), create_square(15, "red")};
+    canvas.rows = 13;
+    canvas.cols = 17;
+
+    std::vector<Transform> transforms = {{"rotate", 45}, {"scale", 0.8}};
+    RenderOptions options;
+    options.seed = 1234;
+    options.layout.type = layoutType;
+    options.layout.seed = 99;
+
+    std::string expected = canvas_list_transform_simpleObject_to_svg(canvas, transforms, -1, options);
+    ShardRenderer renderer = [&](std::ostream& out, const RenderOptions& band) {
+        canvas_list_transform_simpleObject_write(out, canvas, transforms, -1, band);
+    };
+
+    mkdir("shards", 0755);
+    for (int shardCount : {1, 3, 4, 13}) {
+        assert(render_sharded(canvas, renderer, options, shardCount, 4, "shards", "sharded.svg"));
+        assert(read_file("sharded.svg") == expected);
+    }
+}
+
+// A 0 seed would be resolved differently on every node, so it is refused
+void test_render_shard_needs_resolved_seeds() {
+    Canvas canvas;
+    canvas.rows = 2;
+    canvas.cols = 2;
+    Shard shard = plan_shards(canvas, 1, ".")[0];
+    shard.path = "unresolved.svgpart";
+    bool rendered = false;
+    ShardRenderer renderer = [&](std::ostream&, const RenderOptions&) { rendered = true; };
+
+    RenderOptions options;
+    options.seed = 1234;
+    assert(!render_shard(shard, renderer, options));
+    assert(!rendered);
+    options.layout.seed = 99;
+    assert(render_shard(shard, renderer, options));
+    assert(rendered);
+    std::remove(shard.path.c_str());
+}
+
+int main() {
+    test_plan_covers_rows();
+    test_render_shard_needs_resolved_seeds();
+    test_sharded_matches_single("grid");
+    test_sharded_matches_single("jittered");
+    test_sharded_matches_single("poisson");
+    std::cout << "Sharded render tests passed" << std::endl;
+    return 0;
+}
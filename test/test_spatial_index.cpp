@@ -0,0 +1,225 @@
+#include "../include/canvas.hpp"
+#include "../include/spatial_index.hpp"
+#include "../include/svg_utils.hpp"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+// Create a square centered on the origin
+Object create_square(double size, const std::string& color) {
+    Object obj;
+    obj.points = {
+        {-size / 2, -size / 2},
+        {size / 2, -size / 2},
+        {size / 2, size / 2},
+        {-size / 2, size / 2}
+    };
+    obj.color = color;
+    return obj;
+}
+
+Canvas create_canvas(int rows, int cols, double size) {
+    Canvas canvas;
+    canvas.width = 800;
+    canvas.height = 600;
+    canvas.baseObject = {create_square(size, "blue"), create_square(size / 2, "red")};
+    canvas.rows = rows;
+    canvas.cols = cols;
+    return canvas;
+}
+
+bool same_hit(const Hit& a, const Hit& b) {
+    return a.cell == b.cell && a.row == b.row && a.col == b.col && a.objectIndex == b.objectIndex;
+}
+
+std::vector<Point> polygon_of(const SceneIndex& index, size_t k) {
+    return std::vector<Point>(index.points.begin() + index.pointOffsets[k], index.points.begin() + index.pointOffsets[k + 1]);
+}
+
+bool overlap(const std::vector<Point>& a, const std::vector<Point>& b) {
+    bool ab = polygons_overlap(a.data(), a.size(), b.data(), b.size());
+    bool ba = polygons_overlap(b.data(), b.size(), a.data(), a.size());
+    assert(ab == ba);
+    return ab;
+}
+
+void test_polygons_overlap() {
+    std::vector<Point> square = {{0, 0}, {10, 0}, {10, 10}, {0, 10}};
+    assert(overlap(square, {{2, 2}, {8, 2}, {8, 8}, {2, 8}}));          // nested
+    assert(overlap(square, square));                                      // identical
+    assert(overlap(square, {{10, 2}, {20, 2}, {20, 8}, {10, 8}}));        // shared edge piece
+    assert(!overlap(square, {{10, 10}, {20, 10}, {20, 20}, {10, 20}}));   // corner only
+    assert(!overlap(square, {{12, 0}, {20, 0}, {20, 10}, {12, 10}}));     // apart
+    assert(overlap(square, {{5, -5}, {15, 5}, {5, 15}, {-5, 5}}));        // crossing
+    // Crossing only through vertices: the diamond's corners lie on the square's edges
+    assert(overlap(square, {{5, 0}, {10, 5}, {5, 10}, {0, 5}}));
+
+    // A thin U inside a thick U: no edges cross and neither vertex average
+    // lies inside the other polygon
+    std::vector<Point> thick = {{0, 0}, {30, 0}, {30, 30}, {20, 30}, {20, 10}, {10, 10}, {10, 30}, {0, 30}};
+    std::vector<Point> thin = {{2, 2}, {28, 2}, {28, 28}, {22, 28}, {22, 8}, {8, 8}, {8, 28}, {2, 28}};
+    assert(overlap(thick, thin));
+    // ...and one nested in the notch of the other does not overlap
+    assert(!overlap(thick, {{12, 12}, {18, 12}, {18, 28}, {12, 28}}));
+}
+
+void test_pick_matches_brute_force() {
+    Canvas canvas = create_canvas(12, 16, 40);
+    SceneIndex index;
+    RenderOptions options;
+    options.seed = 3;
+    options.layout.type = "jittered";
+    options.layout.seed = 5;
+    options.index = &index;
+    std::ostringstream svg;
+    canvas_list_transform_simpleObject_write(svg, canvas, {{"rotate", 30}, {"scale", 1.5}}, -1, options);
+    index.build(4);
+    assert(index.size() == 12 * 16 * 2);
+
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<double> x(0, 800), y(0, 600);
+    for (int q = 0; q < 2000; ++q) {
+        Point p{x(rng), y(rng)};
+        std::vector<Hit> expected;
+        for (size_t k = index.size(); k-- > 0;) {
+            std::vector<Point> poly = polygon_of(index, k);
+            if (point_in_polygon(p, poly.data(), poly.size())) {
+                expected.push_back(index.hits[k]);
+            }
+        }
+        std::vector<Hit> hits;
+        index.pick(p, hits);
+        assert(hits.size() == expected.size());
+        for (size_t k = 0; k < hits.size(); ++k) {
+            assert(same_hit(hits[k], expected[k]));
+        }
+    }
+
+    // The small red square is painted last, so it is picked first
+    Point center = {(index.boxes[1].minX + index.boxes[1].maxX) / 2, (index.boxes[1].minY + index.boxes[1].maxY) / 2};
+    std::vector<Hit> hits;
+    index.pick(center, hits);
+    assert(!hits.empty() && hits[0].objectIndex == 1);
+}
+
+void test_rect_query_matches_brute_force() {
+    Canvas canvas = create_canvas(20, 20, 30);
+    SceneIndex index;
+    RenderOptions options;
+    options.index = &index;
+    std::ostringstream svg;
+    canvas_transform_composed_write(svg, canvas, {{"rotate", 20}}, options);
+    index.build();
+
+    std::mt19937 rng(2);
+    std::uniform_real_distribution<double> x(0, 800), y(0, 600), size(1, 120);
+    for (int q = 0; q < 500; ++q) {
+        BBox rect;
+        rect.minX = x(rng);
+        rect.minY = y(rng);
+        rect.maxX = rect.minX + size(rng);
+        rect.maxY = rect.minY + size(rng);
+        Point corners[4] = {{rect.minX, rect.minY}, {rect.maxX, rect.minY}, {rect.maxX, rect.maxY}, {rect.minX, rect.maxY}};
+
+        std::vector<Hit> expected;
+        for (size_t k = 0; k < index.size(); ++k) {
+            std::vector<Point> poly = polygon_of(index, k);
+            if (polygons_overlap(poly.data(), poly.size(), corners, 4)) {
+                expected.push_back(index.hits[k]);
+            }
+        }
+        std::vector<Hit> hits;
+        index.query_rect(rect, hits);
+        assert(hits.size() == expected.size());
+        for (size_t k = 0; k < hits.size(); ++k) {
+            assert(same_hit(hits[k], expected[k]));
+        }
+    }
+}
+
+void test_overlapping_cells() {
+    // Squares smaller than the cell pitch never overlap a neighbour
+    Canvas canvas = create_canvas(10, 10, 30);
+    SceneIndex index;
+    RenderOptions options;
+    options.index = &index;
+    std::ostringstream svg;
+    canvas_composed_write(svg, canvas, options);
+    index.build();
+    std::vector<std::pair<Hit, Hit>> pairs;
+    index.overlapping_cells(pairs);
+    assert(pairs.empty());
+
+    // Scaled up, every horizontal and vertical neighbour overlaps
+    index.clear();
+    canvas_transform_composed_write(svg, canvas, {{"scale", 3}}, options);
+    index.build();
+    index.overlapping_cells(pairs);
+    for (const auto& pair : pairs) {
+        assert(pair.first.cell != pair.second.cell);
+    }
+    assert(pairs.size() >= 2 * 10 * 9);
+
+    // Poisson samples sharing a row/col are still different cells
+    pairs.clear();
+    index.clear();
+    Canvas dense = create_canvas(20, 60, 30);
+    options.layout.type = "poisson";
+    options.layout.seed = 4;
+    canvas_composed_write(svg, dense, options);
+    index.build();
+    index.overlapping_cells(pairs);
+    bool sameRowCol = false;
+    for (const auto& pair : pairs) {
+        assert(pair.first.cell != pair.second.cell);
+        sameRowCol = sameRowCol || (pair.first.row == pair.second.row && pair.first.col == pair.second.col);
+    }
+    assert(sameRowCol);
+}
+
+void test_large_scene_timing() {
+    Canvas canvas = create_canvas(500, 1000, 4);
+    canvas.width = 8000;
+    canvas.height = 4000;
+    SceneIndex index;
+    RenderOptions options;
+    options.index = &index;
+    std::ostream discard(nullptr);
+
+    auto start = std::chrono::steady_clock::now();
+    canvas_transform_composed_write(discard, canvas, {{"rotate", 45}}, options);
+    auto rendered = std::chrono::steady_clock::now();
+    index.build();
+    auto built = std::chrono::steady_clock::now();
+    assert(index.size() == 1000000);
+
+    std::mt19937 rng(9);
+    std::uniform_real_distribution<double> x(0, 8000), y(0, 4000);
+    std::vector<Hit> hits;
+    size_t found = 0;
+    const int queries = 10000;
+    for (int q = 0; q < queries; ++q) {
+        hits.clear();
+        index.pick({x(rng), y(rng)}, hits);
+        found += hits.size();
+    }
+    auto picked = std::chrono::steady_clock::now();
+
+    auto ms = [](auto a, auto b) { return std::chrono::duration<double, std::milli>(b - a).count(); };
+    std::cout << index.size() << " polygons: render " << ms(start, rendered) << " ms, build "
+              << ms(rendered, built) << " ms, pick " << ms(built, picked) * 1000 / queries
+              << " us/query (" << found << " hits)" << std::endl;
+}
+
+int main() {
+    test_polygons_overlap();
+    test_pick_matches_brute_force();
+    test_rect_query_matches_brute_force();
+    test_overlapping_cells();
+    test_large_scene_timing();
+    std::cout << "Spatial index tests passed" << std::endl;
+    return 0;
+}
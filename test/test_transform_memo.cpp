@@ -0,0 +1,147 @@
+#include "../include/canvas.hpp"
+#include "../include/geometry.hpp"
+#include "../include/svg_utils.hpp"
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+// Create a square centered on the origin
+Object create_square(double size, const std::string& color) {
+    Object obj;
+    obj.points = {
+        {-size / 2, -size / 2},
+        {size / 2, -size / 2},
+        {size / 2, size / 2},
+        {-size / 2, size / 2}
+    };
+    obj.color = color;
+    return obj;
+}
+
+Canvas create_canvas(int rows, int cols) {
+    Canvas canvas;
+    canvas.width = cols * 40;
+    canvas.height = rows * 40;
+    canvas.baseObject = {create_square(30, "blue"), create_square(20, "red"), create_square(10, "blue")};
+    canvas.rows = rows;
+    canvas.cols = cols;
+    return canvas;
+}
+
+// Absolute polygon points of an SVG document, with <g transform="translate()"> applied
+std::vector<std::vector<Point>> parse_polygons(const std::string& svg) {
+    std::vector<std::vector<Point>> polygons;
+    Point offset{0, 0};
+    size_t pos = 0;
+    for (;;) {
+        size_t group = svg.find("<g transform=\"translate(", pos);
+        size_t polygon = svg.find("<polygon points=\"", pos);
+        size_t close = svg.find("</g>", pos);
+        size_t next = std::min(group, std::min(polygon, close));
+        if (next == std::string::npos) {
+            break;
+        }
+        if (next == group) {
+            char* end = nullptr;
+            offset.x = std::strtod(svg.c_str() + group + 24, &end);
+            offset.y = std::strtod(end + 1, nullptr);
+            pos = group + 1;
+        } else if (next == close) {
+            offset = {0, 0};
+            pos = close + 1;
+        } else {
+            pos = polygon + 17;
+            size_t end = svg.find('"', pos);
+            std::istringstream points(svg.substr(pos, end - pos));
+            std::vector<Point> poly;
+            double x, y;
+            char comma;
+            while (points >> x >> comma >> y) {
+                poly.push_back({x + offset.x, y + offset.y});
+            }
+            polygons.push_back(poly);
+            pos = end;
+        }
+    }
+    return polygons;
+}
+
+void assert_same_geometry(const std::string& a, const std::string& b) {
+    std::vector<std::vector<Point>> pa = parse_polygons(a), pb = parse_polygons(b);
+    assert(pa.size() == pb.size());
+    for (size_t k = 0; k < pa.size(); ++k) {
+        assert(pa[k].size() == pb[k].size());
+        for (size_t i = 0; i < pa[k].size(); ++i) {
+            assert(std::fabs(pa[k][i].x - pb[k][i].x) < 1e-5 && std::fabs(pa[k][i].y - pb[k][i].y) < 1e-5);
+        }
+    }
+}
+
+void test_list_transform_memo() {
+    Canvas canvas = create_canvas(12, 15);
+    std::vector<Transform> transforms = {{"rotate", 30}, {"scale", 0.7}};
+    for (int objectIndex : {-1, 1}) {
+        RenderOptions options;
+        options.seed = 8;
+        std::string plain = canvas_list_transform_simpleObject_to_svg(canvas, transforms, objectIndex, options);
+        options.memoize = "geometry";
+        std::string geometry = canvas_list_transform_simpleObject_to_svg(canvas, transforms, objectIndex, options);
+        options.memoize = "svg";
+        std::string svg = canvas_list_transform_simpleObject_to_svg(canvas, transforms, objectIndex, options);
+
+        assert_same_geometry(plain, geometry);
+        assert_same_geometry(plain, svg);
+        assert(svg.find("<g transform=\"translate(") != std::string::npos);
+
+        std::ofstream file(objectIndex < 0 ? "memo_all_objects.html" : "memo_one_object.html");
+        if (file.is_open()) {
+            file << create_html_wrapper(svg, "Memoized transforms");
+            file.close();
+        }
+    }
+}
+
+void test_transform_composed_memo() {
+    Canvas canvas = create_canvas(10, 10);
+    std::vector<std::pair<std::string, double>> transforms = {{"rotate", 20}, {"rotate", 25}, {"scale", 1.2}, {"translate", 3}};
+    RenderOptions options;
+    std::string plain = canvas_transform_composed_to_svg(canvas, transforms, options);
+    for (const char* mode : {"geometry", "svg"}) {
+        options.memoize = mode;
+        assert_same_geometry(plain, canvas_transform_composed_to_svg(canvas, transforms, options));
+    }
+
+    // Absolute geometry is still produced when the objects must be reduced
+    options.memoize = "svg";
+    options.reduce = "cell";
+    std::string reduced = canvas_transform_composed_to_svg(canvas, transforms, options);
+    assert(reduced.find("<g ") == std::string::npos && !parse_polygons(reduced).empty());
+}
+
+void test_large_grid_timing() {
+    Canvas canvas = create_canvas(400, 400);
+    std::vector<Transform> transforms = {{"rotate", 45}, {"scale", 0.8}};
+    std::ostream discard(nullptr);
+    for (const char* mode : {"none", "geometry", "svg"}) {
+        RenderOptions options;
+        options.seed = 1;
+        options.memoize = mode;
+        auto start = std::chrono::steady_clock::now();
+        canvas_list_transform_simpleObject_write(discard, canvas, transforms, -1, options);
+        auto done = std::chrono::steady_clock::now();
+        std::cout << "400x400 memoize=" << mode << ": "
+                  << std::chrono::duration<double, std::milli>(done - start).count() << " ms" << std::endl;
+    }
+}
+
+int main() {
+    test_list_transform_memo();
+    test_transform_composed_memo();
+    test_large_grid_timing();
+    std::cout << "Transform memo tests passed" << std::endl;
+    return 0;
+}